@@ -13,27 +13,32 @@ BCalTable::BCalTable(char const* filename) {
         file.read(&T,1);
 
         // Throw if this is not the correct type of calibration table
-        if (T != 'B') throw invalid_argument("Supplied calibration table is not a bandpass calibration.");
+        if (!file || T != 'B') throw invalid_argument("Supplied calibration table is not a bandpass calibration.");
 
         // Read in the number of antennas and channels
         file.read(reinterpret_cast<char*>(&_Nant), sizeof(int));
         file.read(reinterpret_cast<char*>(&_Nchan),sizeof(int));
-
-        // Read in the flags
-        bool bool_flags[_Nant*_Nchan*2];
-        _flags = vector<char>(_Nant*_Nchan*2);
-        file.read(reinterpret_cast<char*>(bool_flags), _Nant*_Nchan*2*sizeof(bool));
-        for (int i = 0; i < _Nant*_Nchan*2; ++i) {
-            _flags[i] = static_cast<char>(bool_flags[i]);
-        }
-
-        // Read in the gains
-        float float_gains[_Nant*_Nchan*2*2];
-        _gains = vector<complex<float> >(_Nant*_Nchan*2);
-        file.read(reinterpret_cast<char*>(float_gains), _Nant*_Nchan*2*2*sizeof(float));
-        for (int i = 0; i < _Nant*_Nchan*2; ++i) {
-            _gains[i] = complex<float>(float_gains[2*i],float_gains[2*i+1]);
+        if (!file || _Nant <= 0 || _Nchan <= 0)
+            throw invalid_argument("Bandpass calibration table has an invalid header.");
+
+        // The rest of the file must be exactly the flags and gains
+        const streamoff header = file.tellg();
+        const streamoff num_values = static_cast<streamoff>(_Nant) * _Nchan * 2;
+        file.seekg(0, ios::end);
+        if (file.tellg() - header != num_values * static_cast<streamoff>(sizeof(bool) + 2*sizeof(float)))
+            throw invalid_argument("Bandpass calibration table size does not match its header.");
+        file.seekg(header);
+
+        // Read the flags and gains straight into place. Bools are stored as
+        // one byte each, and complex<float> is laid out as (re, im).
+        _flags.resize(num_values);
+        file.read(&_flags[0], num_values);
+        for (streamoff i = 0; i < num_values; ++i) {
+            _flags[i] = static_cast<char>(_flags[i] != 0);
         }
+        _gains.resize(num_values);
+        file.read(reinterpret_cast<char*>(&_gains[0]), num_values*2*sizeof(float));
+        if (!file) throw runtime_error("Error reading bandpass calibration table.");
     }
     else {
         throw invalid_argument("Could not open calibration table.");
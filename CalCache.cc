@@ -0,0 +1,226 @@
+#include "CalCache.h"
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <stdexcept>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dada {
+
+// Bump when the layout of an entry changes; entries of other versions are
+// rebuilt
+static const uint32_t calCacheVersion = 1;
+static const char calCacheMagic[8] = "DADACAL";
+// Sections start on cache line boundaries so the gains can be used in place
+static const uint64_t calCacheAlign = 64;
+
+struct CalCacheHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t kind;
+    int64_t mtimeSec, mtimeNsec; // Latest modification of the source table
+    uint64_t sourceSize;         // Total size of the source table
+    uint64_t nTime, nGains, nFlags;
+    uint64_t pathOffset, pathLength;
+    uint64_t timesOffset, gainsOffset, flagsOffset;
+    uint64_t fileSize;
+};
+
+static void addStamp(const struct stat &st, long long &mtimeSec, long long &mtimeNsec, unsigned long long &size)
+{
+    if (st.st_mtim.tv_sec > mtimeSec || (st.st_mtim.tv_sec == mtimeSec && st.st_mtim.tv_nsec > mtimeNsec)) {
+        mtimeSec = st.st_mtim.tv_sec;
+        mtimeNsec = st.st_mtim.tv_nsec;
+    }
+    size += st.st_size;
+}
+
+// Modification time and size of a table, which is either a single file
+// (TTCal) or a directory of files (CASA)
+bool CalCache::tableStamp(const std::string &path, Stamp &stamp)
+{
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0)
+        return false;
+    stamp.mtimeSec = stamp.mtimeNsec = 0;
+    stamp.size = 0;
+    addStamp(st, stamp.mtimeSec, stamp.mtimeNsec, stamp.size);
+    if (!S_ISDIR(st.st_mode))
+        return true;
+    // CASA tables rewrite the files inside the directory, which does not
+    // change the directory's own time
+    DIR *dir = opendir(path.c_str());
+    if (dir == NULL)
+        return false;
+    while (struct dirent *entry = readdir(dir)) {
+        std::string file = path + "/" + entry->d_name;
+        if (stat(file.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+            addStamp(st, stamp.mtimeSec, stamp.mtimeNsec, stamp.size);
+    }
+    closedir(dir);
+    return true;
+}
+
+static std::string absolutePath(const std::string &table)
+{
+    char *path = realpath(table.c_str(), NULL);
+    if (path == NULL)
+        return table;
+    std::string result(path);
+    free(path);
+    return result;
+}
+
+static uint64_t alignUp(uint64_t offset)
+{
+    return (offset + calCacheAlign - 1) / calCacheAlign * calCacheAlign;
+}
+
+std::string CalCache::entryPath(const std::string &dir, const std::string &table, char kind)
+{
+    // FNV-1a hash of the table's absolute path
+    const std::string path = absolutePath(table);
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i=0; i<path.size(); ++i) {
+        hash ^= static_cast<unsigned char>(path[i]);
+        hash *= 1099511628211ULL;
+    }
+    std::ostringstream name;
+    name << dir << "/" << std::hex << std::setw(16) << std::setfill('0') << hash << "-" << kind << ".calcache";
+    return name.str();
+}
+
+CalCache::CalCache(const std::string &dir, const std::string &table, char kind) :
+    mDir(dir), mTable(table), mKind(kind), mData(NULL), mSize(0), mNGains(0), mNFlags(0), mGains(NULL), mFlags(NULL)
+{
+    mHaveStamp = tableStamp(mTable, mStamp);
+    map();
+}
+
+CalCache::~CalCache()
+{
+    if (mData != NULL)
+        munmap(const_cast<char *>(mData), mSize);
+}
+
+// Map the entry if it is current for the table
+void CalCache::map()
+{
+    if (!mHaveStamp)
+        return;
+    int fd = open(entryPath(mDir, mTable, mKind).c_str(), O_RDONLY);
+    if (fd < 0)
+        return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(CalCacheHeader)) {
+        close(fd);
+        return;
+    }
+    void *addr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+        return;
+    const char *data = static_cast<const char *>(addr);
+    CalCacheHeader h;
+    memcpy(&h, data, sizeof(h));
+    const std::string path = absolutePath(mTable);
+    const uint64_t size = st.st_size;
+    bool valid = memcmp(h.magic, calCacheMagic, sizeof(h.magic)) == 0 && h.version == calCacheVersion &&
+                 h.kind == static_cast<uint32_t>(mKind) && h.fileSize == size &&
+                 h.mtimeSec == mStamp.mtimeSec && h.mtimeNsec == mStamp.mtimeNsec &&
+                 h.sourceSize == mStamp.size &&
+                 h.nTime > 0 && h.nGains % h.nTime == 0 && h.nFlags % h.nTime == 0 &&
+                 h.pathLength == path.size() && h.pathOffset + h.pathLength <= size &&
+                 h.timesOffset % sizeof(double) == 0 && h.timesOffset + h.nTime * sizeof(double) <= size &&
+                 h.gainsOffset % calCacheAlign == 0 &&
+                 h.gainsOffset + h.nGains * sizeof(std::complex<float>) <= size &&
+                 h.flagsOffset + h.nFlags <= size;
+    // Two tables with the same hash have different paths
+    if (valid)
+        valid = path.compare(0, path.size(), data + h.pathOffset, h.pathLength) == 0;
+    if (!valid) {
+        munmap(addr, size);
+        return;
+    }
+    if (mData != NULL)
+        munmap(const_cast<char *>(mData), mSize);
+    mData = data;
+    mSize = size;
+    const double *times = reinterpret_cast<const double *>(data + h.timesOffset);
+    mTimes.assign(times, times + h.nTime);
+    mNGains = h.nGains;
+    mNFlags = h.nFlags;
+    mGains = reinterpret_cast<const std::complex<float> *>(data + h.gainsOffset);
+    mFlags = data + h.flagsOffset;
+}
+
+void CalCache::update(const std::vector<double> &times, const std::vector<std::complex<float> > &gains,
+                      const std::vector<char> &flags)
+{
+    if (!mHaveStamp)
+        throw std::runtime_error("Error reading calibration table time in CalCache::update: " + mTable);
+    if (times.empty() || gains.size() % times.size() != 0 || flags.size() % times.size() != 0)
+        throw std::length_error("gains or flags size error in CalCache::update");
+    const std::string path = absolutePath(mTable);
+    CalCacheHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, calCacheMagic, sizeof(h.magic));
+    h.version = calCacheVersion;
+    h.kind = mKind;
+    h.mtimeSec = mStamp.mtimeSec;
+    h.mtimeNsec = mStamp.mtimeNsec;
+    h.sourceSize = mStamp.size;
+    h.nTime = times.size();
+    h.nGains = gains.size();
+    h.nFlags = flags.size();
+    h.pathOffset = sizeof(h);
+    h.pathLength = path.size();
+    h.timesOffset = alignUp(h.pathOffset + h.pathLength);
+    h.gainsOffset = alignUp(h.timesOffset + h.nTime * sizeof(double));
+    h.flagsOffset = alignUp(h.gainsOffset + h.nGains * sizeof(std::complex<float>));
+    h.fileSize = h.flagsOffset + h.nFlags;
+
+    // Write to a private name then rename over the entry
+    if (mkdir(mDir.c_str(), 0777) != 0 && errno != EEXIST)
+        throw std::runtime_error("Error creating calibration cache directory " + mDir + ": " + strerror(errno));
+    const std::string entry = entryPath(mDir, mTable, mKind);
+    std::ostringstream tmpName;
+    tmpName << entry << ".tmp." << getpid();
+    const std::string tmp = tmpName.str();
+    {
+        std::ofstream out(tmp.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+        const std::string padding(calCacheAlign, '\0');
+        out.write(reinterpret_cast<const char *>(&h), sizeof(h));
+        out.write(path.data(), path.size());
+        out.write(padding.data(), h.timesOffset - (h.pathOffset + h.pathLength));
+        out.write(reinterpret_cast<const char *>(times.data()), h.nTime * sizeof(double));
+        out.write(padding.data(), h.gainsOffset - (h.timesOffset + h.nTime * sizeof(double)));
+        out.write(reinterpret_cast<const char *>(gains.data()), h.nGains * sizeof(std::complex<float>));
+        out.write(padding.data(), h.flagsOffset - (h.gainsOffset + h.nGains * sizeof(std::complex<float>)));
+        out.write(flags.data(), h.nFlags);
+        out.close();
+        if (!out) {
+            unlink(tmp.c_str());
+            throw std::runtime_error("Error writing calibration cache entry " + tmp);
+        }
+    }
+    if (rename(tmp.c_str(), entry.c_str()) != 0) {
+        int err = errno;
+        unlink(tmp.c_str());
+        throw std::runtime_error("Error renaming calibration cache entry " + entry + ": " + strerror(err));
+    }
+    map();
+    if (!isCurrent())
+        throw std::runtime_error("Error mapping calibration cache entry " + entry);
+}
+
+} // namespace dada
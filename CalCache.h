@@ -0,0 +1,60 @@
+#ifndef CALCACHE_H_
+#define CALCACHE_H_
+
+#include <complex>
+#include <string>
+#include <vector>
+
+namespace dada {
+
+// Compiled calibration table: the inverted gains (or Jones matrices), flags
+// and solution times of a table, kept in a cache directory and memory mapped
+// read-only so concurrent conversions on a node share one copy. An entry is
+// keyed by the table's path and is only used while the table's modification
+// time and size match those it was built from.
+class CalCache
+{
+public:
+    // kind identifies what the table holds, eg 'G' for CASA gains or the
+    // TTCal table type ('B' or 'J')
+    CalCache(const std::string &dir, const std::string &table, char kind);
+    ~CalCache();
+    bool isCurrent() const {return mData != NULL;};
+    int nTime() const {return mTimes.size();};
+    const std::vector<double> &times() const {return mTimes;};
+    size_t nGains() const {return mNGains;};    // Over all solutions
+    size_t nFlags() const {return mNFlags;};
+    const std::complex<float> *gains() const {return mGains;};
+    const char *flags() const {return mFlags;};
+    // Replace the entry with values compiled from the table, atomically so
+    // readers see either the old or the new entry, and map it. The entry is
+    // stamped with the table's time when this CalCache was constructed, so a
+    // table changed while it was being read is compiled again next time.
+    // gains and flags are [solution][...].
+    void update(const std::vector<double> &times, const std::vector<std::complex<float> > &gains,
+                const std::vector<char> &flags);
+    static std::string entryPath(const std::string &dir, const std::string &table, char kind);
+private:
+    struct Stamp {
+        long long mtimeSec, mtimeNsec; // Latest modification of the table
+        unsigned long long size;       // Total size of the table
+    };
+    const std::string mDir, mTable;
+    const char mKind;
+    Stamp mStamp;
+    bool mHaveStamp;
+    const char *mData;
+    size_t mSize;
+    std::vector<double> mTimes;
+    size_t mNGains, mNFlags;
+    const std::complex<float> *mGains;
+    const char *mFlags;
+    void map();
+    static bool tableStamp(const std::string &path, Stamp &stamp);
+    CalCache(const CalCache &);
+    CalCache &operator=(const CalCache &);
+};
+
+} // namespace dada
+
+#endif // CALCACHE_H_
@@ -0,0 +1,196 @@
+#include "ChunkPipeline.h"
+#include "StatsJson.h"
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+
+namespace dada {
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+ChunkPipeline::ChunkPipeline(SortedDada &dada, const std::vector<int> &integrations, int queueDepth) :
+    mDada(dada),
+    mIntegrations(integrations),
+    mQueueDepth(queueDepth),
+    mNextIntegration(0),
+    mRawChunks(queueDepth > 0 ? queueDepth : 1),
+    mSortedChunks(queueDepth > 0 ? queueDepth + 1 : 1),
+    mCurrent(NULL),
+    mWriteStart(0)
+{
+    if (queueDepth < 0)
+        throw std::invalid_argument("ChunkPipeline queue depth must not be negative");
+    if (mQueueDepth == 0)
+        return;
+    for (size_t i=0; i<mRawChunks.size(); ++i)
+        mFreeRaw.push(&mRawChunks[i]);
+    for (size_t i=0; i<mSortedChunks.size(); ++i)
+        mFreeSorted.push(&mSortedChunks[i]);
+    mReadThread = std::thread(&ChunkPipeline::readLoop, this);
+    mSortThread = std::thread(&ChunkPipeline::sortLoop, this);
+}
+
+ChunkPipeline::~ChunkPipeline()
+{
+    closeAll();
+    if (mReadThread.joinable())
+        mReadThread.join();
+    if (mSortThread.joinable())
+        mSortThread.join();
+}
+
+// Wait for the next integration. The chunk stays valid until release().
+SortedChunk &ChunkPipeline::next()
+{
+    double start = now();
+    if (mQueueDepth == 0) {
+        if (mNextIntegration >= mIntegrations.size())
+            throw std::out_of_range("ChunkPipeline::next() called after the last integration");
+        RawChunk &raw = mRawChunks[0];
+        SortedChunk &sorted = mSortedChunks[0];
+        raw.index = mIntegrations[mNextIntegration++];
+        raw.data = mDada.readRawChunk(raw.index, raw.buffer);
+        double read = now();
+        mReadStats.busy += read - start;
+        ++mReadStats.count;
+        sorted.index = raw.index;
+        mDada.sortChunk(raw.index, raw.data, sorted.data, &sorted.flags);
+        mWriteStart = now();
+        mSortStats.busy += mWriteStart - read;
+        ++mSortStats.count;
+        mCurrent = &sorted;
+        return sorted;
+    }
+    if (!mFullSorted.pop(mCurrent)) {
+        std::lock_guard<std::mutex> lock(mErrorMutex);
+        if (mError)
+            std::rethrow_exception(mError);
+        throw std::out_of_range("ChunkPipeline::next() called after the last integration");
+    }
+    mWriteStart = now();
+    mWriteStats.stallIn += mWriteStart - start;
+    return *mCurrent;
+}
+
+// Hand the chunk from next() back once it has been written.
+void ChunkPipeline::release()
+{
+    if (mCurrent == NULL)
+        return;
+    mWriteStats.busy += now() - mWriteStart;
+    ++mWriteStats.count;
+    if (mQueueDepth > 0)
+        mFreeSorted.push(mCurrent);
+    mCurrent = NULL;
+}
+
+void ChunkPipeline::readLoop()
+{
+    try {
+        for (size_t i=0; i<mIntegrations.size(); ++i) {
+            RawChunk *raw;
+            double start = now();
+            if (!mFreeRaw.pop(raw))
+                return;
+            double got = now();
+            mReadStats.stallOut += got - start;
+            raw->index = mIntegrations[i];
+            raw->data = mDada.readRawChunk(raw->index, raw->buffer);
+            mReadStats.busy += now() - got;
+            ++mReadStats.count;
+            mFullRaw.push(raw);
+        }
+        mFullRaw.close();
+    } catch (...) {
+        fail();
+    }
+}
+
+void ChunkPipeline::sortLoop()
+{
+    try {
+        while (true) {
+            RawChunk *raw;
+            SortedChunk *sorted;
+            double start = now();
+            if (!mFullRaw.pop(raw))
+                break;
+            double gotRaw = now();
+            mSortStats.stallIn += gotRaw - start;
+            if (!mFreeSorted.pop(sorted))
+                return;
+            double gotSorted = now();
+            mSortStats.stallOut += gotSorted - gotRaw;
+            sorted->index = raw->index;
+            mDada.sortChunk(raw->index, raw->data, sorted->data, &sorted->flags);
+            mSortStats.busy += now() - gotSorted;
+            ++mSortStats.count;
+            mFreeRaw.push(raw);
+            mFullSorted.push(sorted);
+        }
+        mFullSorted.close();
+    } catch (...) {
+        fail();
+    }
+}
+
+// Record the exception from a stage thread and shut the pipeline down.
+void ChunkPipeline::fail()
+{
+    {
+        std::lock_guard<std::mutex> lock(mErrorMutex);
+        if (!mError)
+            mError = std::current_exception();
+    }
+    closeAll();
+}
+
+void ChunkPipeline::closeAll()
+{
+    mFreeRaw.close();
+    mFullRaw.close();
+    mFreeSorted.close();
+    mFullSorted.close();
+}
+
+void ChunkPipeline::printStats(std::ostream &os) const
+{
+    const char *names[] = {"read", "sort", "write"};
+    const StageStats *stats[] = {&mReadStats, &mSortStats, &mWriteStats};
+    os << "Stage    count     busy(s)  stall-in(s) stall-out(s)" << std::endl;
+    for (int i=0; i<3; ++i) {
+        os << std::left << std::setw(6) << names[i] << std::right
+           << std::setw(8) << stats[i]->count
+           << std::fixed << std::setprecision(3)
+           << std::setw(12) << stats[i]->busy
+           << std::setw(13) << stats[i]->stallIn
+           << std::setw(13) << stats[i]->stallOut << std::endl;
+    }
+}
+
+// The stage counters as a JSON object. Throughputs are over each stage's
+// busy time, with inBytes read and outBytes sorted and written per
+// integration.
+void ChunkPipeline::printStatsJson(std::ostream &os, double inBytes, double outBytes) const
+{
+    const char *names[] = {"read", "sort", "write"};
+    const StageStats *stats[] = {&mReadStats, &mSortStats, &mWriteStats};
+    const double bytes[] = {inBytes, outBytes, outBytes};
+    os << "{";
+    for (int i=0; i<3; ++i) {
+        const double busy = stats[i]->busy;
+        os << (i > 0 ? ", " : "") << "\"" << names[i] << "\": {"
+           << "\"count\": " << stats[i]->count
+           << ", \"busy_s\": " << busy
+           << ", \"stall_in_s\": " << stats[i]->stallIn
+           << ", \"stall_out_s\": " << stats[i]->stallOut
+           << ", \"mb_per_s\": " << jsonRate(stats[i]->count * bytes[i] / 1e6, busy)
+           << ", \"ints_per_s\": " << jsonRate(stats[i]->count, busy) << "}";
+    }
+    os << "}";
+}
+
+} // namespace dada
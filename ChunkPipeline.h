@@ -0,0 +1,114 @@
+#ifndef CHUNKPIPELINE_H_
+#define CHUNKPIPELINE_H_
+
+#include "SortedDada.h"
+#include <complex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <thread>
+#include <vector>
+
+namespace dada {
+
+// A reordered integration, as handed to the writer.
+struct SortedChunk
+{
+    int index; // Integration number within the dada file
+    std::vector<std::complex<float> > data;
+    std::shared_ptr<const FlagMask> flags; // NULL when calibration does not flag the data
+};
+
+// FIFO used to pass buffers between pipeline stages. The number of buffers
+// in circulation bounds its length. pop() returns false once the queue has
+// been closed and emptied.
+template <typename T>
+class WorkQueue
+{
+public:
+    WorkQueue() : mClosed(false) {}
+    void push(const T &item)
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mItems.push_back(item);
+        mReady.notify_one();
+    }
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mReady.wait(lock, [this] {return mClosed || !mItems.empty();});
+        if (mItems.empty())
+            return false;
+        item = mItems.front();
+        mItems.pop_front();
+        return true;
+    }
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mClosed = true;
+        mReady.notify_all();
+    }
+private:
+    std::deque<T> mItems;
+    std::mutex mMutex;
+    std::condition_variable mReady;
+    bool mClosed;
+};
+
+// Delivers the requested integrations of a SortedDada in order. With a queue
+// depth of zero each integration is read and sorted when next() is called.
+// Otherwise reading and reordering run on their own threads, up to queueDepth
+// integrations ahead of the caller, so that reading integration t+1, sorting
+// t and writing t-1 overlap.
+class ChunkPipeline
+{
+public:
+    struct StageStats {
+        StageStats() : count(0), busy(0), stallIn(0), stallOut(0) {}
+        long count;
+        double busy;     // Seconds spent working
+        double stallIn;  // Seconds spent waiting for input
+        double stallOut; // Seconds spent waiting for a free output buffer
+    };
+    ChunkPipeline(SortedDada &dada, const std::vector<int> &integrations, int queueDepth);
+    ~ChunkPipeline();
+    SortedChunk &next();
+    void release();
+    const StageStats &readStats() const {return mReadStats;};
+    const StageStats &sortStats() const {return mSortStats;};
+    const StageStats &writeStats() const {return mWriteStats;};
+    void printStats(std::ostream &os) const;
+    void printStatsJson(std::ostream &os, double inBytes, double outBytes) const;
+private:
+    struct RawChunk {
+        int index;
+        const float *data;
+        std::vector<float> buffer;
+    };
+    SortedDada &mDada;
+    const std::vector<int> mIntegrations;
+    const int mQueueDepth;
+    size_t mNextIntegration; // Only used without threads
+    std::vector<RawChunk> mRawChunks;
+    std::vector<SortedChunk> mSortedChunks;
+    WorkQueue<RawChunk*> mFreeRaw, mFullRaw;
+    WorkQueue<SortedChunk*> mFreeSorted, mFullSorted;
+    SortedChunk *mCurrent;
+    double mWriteStart;
+    StageStats mReadStats, mSortStats, mWriteStats;
+    std::mutex mErrorMutex;
+    std::exception_ptr mError;
+    std::thread mReadThread, mSortThread;
+    void readLoop();
+    void sortLoop();
+    void fail();
+    void closeAll();
+};
+
+} // namespace dada
+
+#endif // CHUNKPIPELINE_H_
@@ -27,6 +27,7 @@ public:
     double finishTimeMJD() const {return unix2mjd(mFinishTime);}
     int nBaseline() const {return mNBaseline;};
     int headerSize() const {return mHeaderSize;};
+    long bytesPerAvg() const {return mBytesPerAvg;};
     const std::map<std::string,std::string>& rawValues() const {return mHeaderMap;};
     static double str2epoch(const char *time, double offsetSec);
     static double unix2mjd(double time);
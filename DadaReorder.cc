@@ -8,26 +8,37 @@
 #include <cstdlib>
 #include <iostream>
 #include <cstring>
+#include <algorithm>
 
 namespace dada {
 
 DadaReorder::DadaReorder(int nAnt, int nFreq, int nPol, int nCorr) :
-    mApplyCal(false), mAutosOnly(false), mIndexIsValid(false),
+    mApplyCal(false), mApplyJones(false), mAutosOnly(false), mIndexIsValid(false), mCalIsValid(false),
     mNAnt(nAnt), mNFreq(nFreq), mNPol(nPol), mNCorr(nCorr),
     mNBaseline((nAnt + 1) * nAnt/2), mGpuBaselines(nAnt * (nAnt / 2 + 1)),
     mGpuHalfBlock(mGpuBaselines * nFreq * nCorr),
+    mFirstFreq(0), mNOutFreq(nFreq),
     mLineMap(new int[nAnt*nPol]),
     mBaselineIndex(nAnt * nPol, std::vector<int>(nAnt * nPol)),
-    mConjBaseline(nAnt * nPol, std::vector<int>(nAnt * nPol, -1))
+    mConjBaseline(nAnt * nPol, std::vector<int>(nAnt * nPol, -1)),
+    mGatherKernel(selectGatherRunKernel()),
+    mMulKernel(selectComplexMulKernel()),
+    mJonesKernel(selectJonesKernel(false)),
+    mGainWeight(0),
+    mInterpWeight(-1),
+    mPool(NULL)
 {
     // Initialize to nominal mapping
     for (int i=0; i<mNAnt*mNPol; ++i)
         mLineMap[i] = i;
+    selectAllBaselines();
+    resetGains();
 }
 
 DadaReorder::~DadaReorder()
 {
     delete[] mLineMap;
+    delete mPool;
 }
 
 void DadaReorder::setLineMapping(int corrInput, int cable)
@@ -73,8 +84,79 @@ int DadaReorder::setLineMappingFromFile(const char *filename)
     return read;
 }
 
+void DadaReorder::selectChannels(int firstFreq, int nFreq)
+{
+    if (firstFreq < 0 || nFreq < 1 || firstFreq + nFreq > mNFreq) {
+        std::stringstream message;
+        message << "Channel selection " << firstFreq << "-" << firstFreq + nFreq - 1
+                << " is not valid (" << mNFreq << " channels)";
+        throw std::out_of_range(message.str());
+    }
+    mFirstFreq = firstFreq;
+    mNOutFreq = nFreq;
+    mIndexIsValid = false;
+}
+
+// Output only the listed baselines, in the order given. Each pair must have
+// ant1 <= ant2. Empty lists select every baseline.
+void DadaReorder::selectBaselines(const std::vector<int> &ant1, const std::vector<int> &ant2)
+{
+    if (ant1.size() != ant2.size())
+        throw std::length_error("DadaReorder::selectBaselines() antenna lists differ in length");
+    mAutosOnly = false;
+    if (ant1.empty()) {
+        selectAllBaselines();
+        return;
+    }
+    for (size_t i=0; i<ant1.size(); ++i) {
+        if (ant1[i] < 0 || ant1[i] > ant2[i] || ant2[i] >= mNAnt) {
+            std::stringstream message;
+            message << "Baseline " << ant1[i] << "-" << ant2[i] << " is not valid in DadaReorder::selectBaselines";
+            throw std::out_of_range(message.str());
+        }
+    }
+    mOutAnt1 = ant1;
+    mOutAnt2 = ant2;
+    mIndexIsValid = false;
+}
+
+// Output the auto-correlation of every antenna. The gather plan then only
+// touches the diagonal 2x2 blocks of the xGPU triangle, which live in the
+// XX and YY quarters of each frequency block, so readers skip the other two.
+void DadaReorder::selectAutos()
+{
+    mAutosOnly = true;
+    selectAllBaselines();
+}
+
+void DadaReorder::selectAllBaselines()
+{
+    mOutAnt1.clear();
+    mOutAnt2.clear();
+    for (int ant1=0; ant1<mNAnt; ant1++) {
+        for (int ant2=ant1; ant2<mNAnt; ant2++) {
+            if (mAutosOnly && ant1 != ant2)
+                continue;
+            mOutAnt1.push_back(ant1);
+            mOutAnt2.push_back(ant2);
+        }
+    }
+    mIndexIsValid = false;
+}
+
+// The runs of raw input read by sortData with the current selection, sorted
+// by offset. Readers can skip everything else.
+const std::vector<DadaReorder::InputRange> &DadaReorder::inputRanges()
+{
+    if (!mIndexIsValid)
+        buildIndex();
+    return mInputRanges;
+}
+
 void DadaReorder::buildIndex()
 {
+    for (int i=0; i<mNAnt*mNPol; i++)
+        std::fill(mConjBaseline[i].begin(), mConjBaseline[i].end(), -1);
     for (int i=0; i<mNAnt/2; i++) {
         for (int rx=0; rx<2; rx++) {
             for (int j=0; j<=i; j++) {
@@ -103,119 +185,334 @@ void DadaReorder::buildIndex()
             }
         }
     }
+    buildGatherPlan();
+    buildInputRanges();
+    mIndexIsValid = true;
+    mCalIsValid = false;
+    mProductIsValid = false;
+}
+
+// Flatten the line-mapped index into the order sortData writes its output, so
+// that the per-integration loop streams through one contiguous table.
+void DadaReorder::buildGatherPlan()
+{
+    mGatherPlan.resize(mOutAnt1.size() * mNCorr);
+    mRunPattern.assign(mOutAnt1.size(), RUN_NONE);
+    for (size_t baseline=0; baseline<mOutAnt1.size(); baseline++) {
+        for (int pol1=0; pol1<mNPol; pol1++) {
+            int line1 = 2*mOutAnt1[baseline] + pol1;
+            for (int pol2=0; pol2<mNPol; pol2++) {
+                int line2 = 2*mOutAnt2[baseline] + pol2;
+                GatherEntry &entry = mGatherPlan[baseline * mNCorr + pol1 * mNPol + pol2];
+                entry.offset = mBaselineIndex[line1][line2];
+                entry.sign = static_cast<float>(mConjBaseline[line1][line2]);
+            }
+        }
+        // Cross correlations without remapping are four consecutive raw
+        // values, possibly with XY/YX swapped.
+        if (mNCorr == 4) {
+            const GatherEntry *plan = &mGatherPlan[baseline * mNCorr];
+            int base = plan[0].offset;
+            if (plan[1].offset == base+1 && plan[2].offset == base+2 && plan[3].offset == base+3)
+                mRunPattern[baseline] = RUN_IDENTITY;
+            else if (plan[1].offset == base+2 && plan[2].offset == base+1 && plan[3].offset == base+3)
+                mRunPattern[baseline] = RUN_TRANSPOSED;
+        }
+    }
+}
+
+// Every selected channel reads the same offsets within its frequency block of
+// each (real and imaginary) half. Merge those into runs, then join runs that
+// meet across neighbouring channels, so a full selection is a single range.
+void DadaReorder::buildInputRanges()
+{
+    const int freqStride = mGpuBaselines * mNCorr;
+    std::vector<char> used(freqStride, false);
+    for (size_t i=0; i<mGatherPlan.size(); i++)
+        used[mGatherPlan[i].offset] = true;
+    std::vector<InputRange> blockRuns;
+    for (int i=0; i<freqStride; i++) {
+        if (!used[i])
+            continue;
+        if (!blockRuns.empty() && blockRuns.back().offset + blockRuns.back().length == static_cast<size_t>(i)) {
+            blockRuns.back().length++;
+        } else {
+            InputRange run = {static_cast<size_t>(i), 1};
+            blockRuns.push_back(run);
+        }
+    }
+    mInputRanges.clear();
+    for (int half=0; half<2; half++) {
+        for (int f=mFirstFreq; f<mFirstFreq+mNOutFreq; f++) {
+            size_t block = static_cast<size_t>(half) * mGpuHalfBlock + static_cast<size_t>(f) * freqStride;
+            for (size_t i=0; i<blockRuns.size(); i++) {
+                InputRange run = {block + blockRuns[i].offset, blockRuns[i].length};
+                if (!mInputRanges.empty() && mInputRanges.back().offset + mInputRanges.back().length == run.offset)
+                    mInputRanges.back().length += run.length;
+                else
+                    mInputRanges.push_back(run);
+            }
+        }
+    }
+}
+
+void DadaReorder::applyGains(const std::complex<float> *gains, const char *gainFlags)
+{
+    applyGains(gains, gainFlags, NULL, NULL);
 }
 
-void DadaReorder::applyGains(std::complex<float> *gains, char *gainFlags, char *outVisFlags)
+// Interpolate between two gain solutions, as CASA does: the amplitude and
+// phase of each antenna's gain go linearly from gains0 to gains1 with the
+// weight from setGainWeight(). A flag in either solution flags the output.
+// gains1 may be NULL to apply gains0 alone.
+// The products for gains0 alone are kept while its pointer is passed again.
+// Call resetGains() before changing the values behind a pointer.
+void DadaReorder::applyGains(const std::complex<float> *gains0, const char *gainFlags0,
+                             const std::complex<float> *gains1, const char *gainFlags1)
 {
+    mProductIsValid = mProductIsValid && gains0 == mGains[0];
     mApplyCal = true;
-    mGains = gains;
-    mGainFlags = gainFlags;
-    mOutVisFlags = outVisFlags;
+    mCalIsValid = false;
+    mGains[0] = gains0;
+    mGainFlags[0] = gainFlags0;
+    mGains[1] = gains1;
+    mGainFlags[1] = gainFlags1;
+    mInterpWeight = -1;
+}
+
+void DadaReorder::resetGains()
+{
+    mApplyCal = false;
+    mCalIsValid = false;
+    mGains[0] = mGains[1] = NULL;
+    mGainFlags[0] = mGainFlags[1] = NULL;
+    mProductIsValid = false;
+    mCalProduct.clear();
+    mInterpWeight = -1;
 }
 
-void DadaReorder::applyJones(std::complex<float> *jones, char *jonesFlags, char *outVisFlags)
+void DadaReorder::applyJones(const std::complex<float> *jones, const char *jonesFlags)
 {
     if (mNPol != 2)
         throw std::logic_error("must have fully polarized visibilities to apply a Jones matrix calibration");
     mApplyJones = true;
+    mCalIsValid = false;
     mJones = jones;
     mJonesFlags = jonesFlags;
-    mOutVisFlags = outVisFlags;
+    // Polcal solutions are often purely diagonal (no leakage terms)
+    bool diagonal = true;
+    for (int i=0; i<mNAnt*mNFreq && diagonal; i++)
+        diagonal = jones[4*i+1] == std::complex<float>(0) && jones[4*i+2] == std::complex<float>(0);
+    mJonesKernel = selectJonesKernel(diagonal);
 }
 
-void DadaReorder::sortData(float *dadaArr, float *outArr)
+// The gains and flags only change between solution intervals, so work out
+// the gain product and the flags of each output visibility once per
+// solution. Applying a bandpass is then a single streamed complex multiply
+// per visibility.
+void DadaReorder::buildCalPlan()
 {
-	if (!mIndexIsValid)
-        buildIndex();
-    int freqs_x_pols = mNFreq * mNPol;
-    int out_offset=0, baseline=-1;
-    for (int ant1=0; ant1<mNAnt; ant1++) {
-        for (int ant2=ant1; ant2<mNAnt; ant2++) {
-            if (mAutosOnly && ant1 != ant2)
-                continue;
-            baseline++;
-            for (int f=0; f<mNFreq; f++) {
-                int dada_freq_offset = f * mGpuBaselines * mNCorr;
-                for (int pol1=0; pol1<mNPol; pol1++) {
-                    int line1 = 2*ant1 + pol1;
-                    for (int pol2=0; pol2<mNPol; pol2++) {
-                        int line2 = 2*ant2 + pol2;
-                        int dada_index = dada_freq_offset + mBaselineIndex[line1][line2];
-                        if (mApplyCal) {
-                            float vr = dadaArr[dada_index];
-                            float vi = mConjBaseline[line1][line2] * dadaArr[dada_index+mGpuHalfBlock];
-                            int l0_index = ant1 * freqs_x_pols + f * mNPol + pol1;
-                            int l1_index = ant2 * freqs_x_pols + f * mNPol + pol2;
-                            std::complex<float> g0 = mGains[l0_index];
-                            float g0r = g0.real();
-                            float g0i = g0.imag();
-                            std::complex<float> g1 = mGains[l1_index];
-                            float g1r = g1.real();
-                            float g1i = g1.imag();
-                            // (G0)(V)(G1)* factored out:
-                            outArr[out_offset] = g0r*vr*g1r - g0i*vi*g1r + g0i*vr*g1i + g0r*vi*g1i;
-                            outArr[out_offset+1] = g0i*vr*g1r + g0r*vi*g1r - g0r*vr*g1i + g0i*vi*g1i;
-                            int corr = pol1 * mNPol + pol2;
-                            bool gainFlag0 = static_cast<bool>(mGainFlags[l0_index]);
-                            bool gainFlag1 = static_cast<bool>(mGainFlags[l1_index]);
-                            mOutVisFlags[baseline * mNFreq * mNCorr + f * mNCorr + corr] = static_cast<char>(gainFlag0 || gainFlag1);
-                        } else {
-                            outArr[out_offset] = dadaArr[dada_index];
-                            outArr[out_offset+1] = mConjBaseline[line1][line2] * dadaArr[dada_index+mGpuHalfBlock];
-                        }
-                        out_offset += 2;
+    const int nOutBaseline = mOutAnt1.size();
+    const int freqs_x_pols = mNFreq * mNPol;
+    if (mApplyCal && mGains[1] == NULL && !mProductIsValid)
+        buildCalProduct();
+    FlagMask *flags = new FlagMask(outputSize());
+    size_t i = 0;
+    for (int baseline=0; baseline<nOutBaseline; baseline++) {
+        const int ant1 = mOutAnt1[baseline];
+        const int ant2 = mOutAnt2[baseline];
+        for (int f=mFirstFreq; f<mFirstFreq+mNOutFreq; f++) {
+            bool jonesFlag = mApplyJones && (static_cast<bool>(mJonesFlags[ant1*mNFreq + f]) ||
+                                             static_cast<bool>(mJonesFlags[ant2*mNFreq + f]));
+            for (int pol1=0; pol1<mNPol; pol1++) {
+                for (int pol2=0; pol2<mNPol; pol2++, i++) {
+                    bool flag = jonesFlag;
+                    for (int solution=0; solution<2 && mApplyCal; solution++) {
+                        if (mGainFlags[solution] == NULL)
+                            continue;
+                        int l0_index = ant1 * freqs_x_pols + f * mNPol + pol1;
+                        int l1_index = ant2 * freqs_x_pols + f * mNPol + pol2;
+                        flag = flag || static_cast<bool>(mGainFlags[solution][l0_index])
+                                    || static_cast<bool>(mGainFlags[solution][l1_index]);
                     }
+                    if (flag)
+                        flags->set(i);
                 }
-                if (mApplyJones) {
-                    // mApplyJones is only true if mNPol is 2.
-                    // Therefore we can specialize on the case of 2x2 correlation products.
-
-                    // Start be rewinding the offset counter so that we can take another pass
-                    // over the same set of visibilities.
-                    int offset = out_offset - 2*mNPol*mNPol;
-                    int j0_offset = ant1*mNFreq*mNPol*mNPol + f*mNPol*mNPol;
-                    int j1_offset = ant2*mNFreq*mNPol*mNPol + f*mNPol*mNPol;
-
-                    // Now compute the matrix product (J0)(V)(J1)*
-                    std::complex<float> vxx = std::complex<float>(outArr[offset+0],outArr[offset+1]);
-                    std::complex<float> vxy = std::complex<float>(outArr[offset+2],outArr[offset+3]);
-                    std::complex<float> vyx = std::complex<float>(outArr[offset+4],outArr[offset+5]);
-                    std::complex<float> vyy = std::complex<float>(outArr[offset+6],outArr[offset+7]);
-
-                    std::complex<float> a0 = mJones[j0_offset+0];
-                    std::complex<float> b0 = mJones[j0_offset+1];
-                    std::complex<float> c0 = mJones[j0_offset+2];
-                    std::complex<float> d0 = mJones[j0_offset+3];
-
-                    std::complex<float> a1 = std::conj(mJones[j1_offset+0]);
-                    std::complex<float> b1 = std::conj(mJones[j1_offset+1]);
-                    std::complex<float> c1 = std::conj(mJones[j1_offset+2]);
-                    std::complex<float> d1 = std::conj(mJones[j1_offset+3]);
-
-                    std::complex<float> vxx_ = a0*vxx*a1 + b0*vyx*a1 + a0*vxy*b1 + b0*vyy*b1;
-                    std::complex<float> vxy_ = a0*vxx*c1 + b0*vyx*c1 + a0*vxy*d1 + b0*vyy*d1;
-                    std::complex<float> vyx_ = c0*vxx*a1 + d0*vyx*a1 + c0*vxy*b1 + d0*vyy*b1;
-                    std::complex<float> vyy_ = c0*vxx*c1 + d0*vyx*c1 + c0*vxy*d1 + d0*vyy*d1;
-
-                    outArr[offset+0] = std::real(vxx_);
-                    outArr[offset+1] = std::imag(vxx_);
-                    outArr[offset+2] = std::real(vxy_);
-                    outArr[offset+3] = std::imag(vxy_);
-                    outArr[offset+4] = std::real(vyx_);
-                    outArr[offset+5] = std::imag(vyx_);
-                    outArr[offset+6] = std::real(vyy_);
-                    outArr[offset+7] = std::imag(vyy_);
-
-                    // Apply flags
-                    if (static_cast<bool>(mJonesFlags[ant1*mNFreq + f]) || static_cast<bool>(mJonesFlags[ant2*mNFreq + f])) {
-                        for (int i = 0; i < mNPol*mNPol; ++i) {
-                            mOutVisFlags[baseline*mNFreq*mNCorr + f*mNCorr + i] = static_cast<char>(true);
-                        }
-                    }
+            }
+        }
+    }
+    // Without any flags there is no mask, so the chunks say nothing is
+    // flagged and the writer and averager skip the per-visibility tests
+    if (flags->any()) {
+        mVisFlags.reset(flags);
+    } else {
+        delete flags;
+        mVisFlags.reset();
+    }
+    mCalIsValid = true;
+}
+
+void DadaReorder::buildCalProduct()
+{
+    const int nOutBaseline = mOutAnt1.size();
+    const int freqs_x_pols = mNFreq * mNPol;
+    const std::complex<float> *gains = mGains[0];
+    std::vector<std::complex<float> > &product = mCalProduct;
+    product.resize(outputSize());
+    size_t i = 0;
+    for (int baseline=0; baseline<nOutBaseline; baseline++) {
+        const int ant1 = mOutAnt1[baseline];
+        const int ant2 = mOutAnt2[baseline];
+        for (int f=mFirstFreq; f<mFirstFreq+mNOutFreq; f++) {
+            for (int pol1=0; pol1<mNPol; pol1++) {
+                for (int pol2=0; pol2<mNPol; pol2++, i++) {
+                    int l0_index = ant1 * freqs_x_pols + f * mNPol + pol1;
+                    int l1_index = ant2 * freqs_x_pols + f * mNPol + pol2;
+                    // (G0)(V)(G1)* = (G0 G1*) V
+                    product[i] = gains[l0_index] * std::conj(gains[l1_index]);
                 }
             }
         }
     }
+    mProductIsValid = true;
+}
+
+// The (inverse) gains between the two solutions at mGainWeight. The
+// amplitude of the gains themselves, 1/|g| of the inverses, and the phase are
+// interpolated linearly, the phase the short way round.
+void DadaReorder::interpolateGains()
+{
+    const size_t size = static_cast<size_t>(mNAnt) * mNFreq * mNPol;
+    const float w = mGainWeight;
+    mInterpGains.resize(size);
+    for (size_t i=0; i<size; i++) {
+        const std::complex<float> g0 = mGains[0][i], g1 = mGains[1][i];
+        const float a0 = std::abs(g0), a1 = std::abs(g1);
+        if (a0 == 0 || a1 == 0) {
+            mInterpGains[i] = 0;
+            continue;
+        }
+        const float amp = 1 / ((1 - w) / a0 + w / a1);
+        const float phase = std::arg(g0) + w * std::arg(g1 * std::conj(g0));
+        mInterpGains[i] = std::polar(amp, phase);
+    }
+    mInterpWeight = mGainWeight;
+}
+
+// Gain products of one output baseline for input channels [firstFreq,
+// lastFreq), from the interpolated gains
+void DadaReorder::interpolatedProduct(int baseline, int firstFreq, int lastFreq,
+                                      std::complex<float> *product) const
+{
+    const int freqs_x_pols = mNFreq * mNPol;
+    const std::complex<float> *g0 = &mInterpGains[mOutAnt1[baseline] * freqs_x_pols];
+    const std::complex<float> *g1 = &mInterpGains[mOutAnt2[baseline] * freqs_x_pols];
+    for (int f=firstFreq; f<lastFreq; f++) {
+        for (int pol1=0; pol1<mNPol; pol1++) {
+            for (int pol2=0; pol2<mNPol; pol2++)
+                *product++ = g0[f * mNPol + pol1] * std::conj(g1[f * mNPol + pol2]);
+        }
+    }
+}
+
+void DadaReorder::setNumThreads(int nThreads)
+{
+    delete mPool;
+    mPool = NULL;
+    if (nThreads > 1)
+        mPool = new ThreadPool(nThreads);
+}
+
+void DadaReorder::sortData(const float *dadaArr, float *outArr)
+{
+    if (!mIndexIsValid)
+        buildIndex();
+    if (!flagsData())
+        mVisFlags.reset();
+    else if (!mCalIsValid)
+        buildCalPlan();
+    if (mApplyCal && mGains[1] != NULL && mInterpWeight != mGainWeight)
+        interpolateGains();
+    const int nOutBaseline = mOutAnt1.size();
+    if (mPool == NULL) {
+        sortRange(dadaArr, outArr, 0, nOutBaseline, mFirstFreq, mFirstFreq + mNOutFreq);
+        return;
+    }
+    // Split by baseline range, unless there are too few baselines (e.g. autos
+    // only) to keep every thread busy, in which case split by channel range.
+    const int nTasks = 4 * mPool->size();
+    if (nOutBaseline >= nTasks) {
+        mPool->run(nTasks, [&](int task) {
+            sortRange(dadaArr, outArr, static_cast<long>(nOutBaseline) * task / nTasks,
+                      static_cast<long>(nOutBaseline) * (task+1) / nTasks, mFirstFreq, mFirstFreq + mNOutFreq);
+        });
+    } else {
+        const int nChanTasks = std::min(nTasks, mNOutFreq);
+        mPool->run(nChanTasks, [&](int task) {
+            sortRange(dadaArr, outArr, 0, nOutBaseline,
+                      mFirstFreq + mNOutFreq * task / nChanTasks, mFirstFreq + mNOutFreq * (task+1) / nChanTasks);
+        });
+    }
+}
+
+// Reorder output baselines [firstBaseline, lastBaseline) for input channels
+// [firstFreq, lastFreq), which must lie within the selected channels.
+// Disjoint ranges can be sorted concurrently.
+void DadaReorder::sortRange(const float *dadaArr, float *outArr, int firstBaseline, int lastBaseline,
+                            int firstFreq, int lastFreq)
+{
+    const int baselineFloats = mNOutFreq * mNCorr * 2;
+    const bool interpolate = mApplyCal && mGains[1] != NULL;
+    std::vector<std::complex<float> > interpProduct(interpolate ? (lastFreq - firstFreq) * mNCorr : 0);
+    for (int baseline=firstBaseline; baseline<lastBaseline; baseline++) {
+        float *out = outArr + baseline * baselineFloats;
+        gatherBaseline(dadaArr, baseline, firstFreq, lastFreq, out);
+        if (mApplyCal) {
+            const std::complex<float> *product;
+            if (interpolate) {
+                interpolatedProduct(baseline, firstFreq, lastFreq, interpProduct.data());
+                product = interpProduct.data();
+            } else {
+                product = &mCalProduct[(static_cast<size_t>(baseline) * mNOutFreq + firstFreq - mFirstFreq) * mNCorr];
+            }
+            mMulKernel(reinterpret_cast<const float *>(product), out + (firstFreq - mFirstFreq) * 2*mNCorr,
+                       (lastFreq - firstFreq) * mNCorr);
+        }
+        // Applied while the baseline is still in cache from the gather.
+        // mApplyJones is only true if mNPol is 2, so there are four
+        // correlations per channel.
+        if (mApplyJones) {
+            const int jonesFloats = 2*mNPol*mNPol;
+            mJonesKernel(reinterpret_cast<const float *>(mJones) + (mOutAnt1[baseline] * mNFreq + firstFreq) * jonesFloats,
+                         reinterpret_cast<const float *>(mJones) + (mOutAnt2[baseline] * mNFreq + firstFreq) * jonesFloats,
+                         lastFreq - firstFreq, out + (firstFreq - mFirstFreq) * jonesFloats);
+        }
+    }
+}
+
+void DadaReorder::gatherBaseline(const float *dadaArr, int baseline, int firstFreq, int lastFreq,
+                                 float *outArr) const
+{
+    const int freqStride = mGpuBaselines * mNCorr;
+    const GatherEntry *plan = &mGatherPlan[baseline * mNCorr];
+    RunPattern pattern = static_cast<RunPattern>(mRunPattern[baseline]);
+    if (pattern != RUN_NONE) {
+        const float sign[4] = {plan[0].sign, plan[1].sign, plan[2].sign, plan[3].sign};
+        const float *re = dadaArr + firstFreq * freqStride + plan[0].offset;
+        mGatherKernel(re, re + mGpuHalfBlock, freqStride, sign, pattern, lastFreq - firstFreq,
+                      outArr + (firstFreq - mFirstFreq) * 2*mNCorr);
+        return;
+    }
+    outArr += (firstFreq - mFirstFreq) * 2*mNCorr;
+    for (int f=firstFreq; f<lastFreq; f++) {
+        const float *re = dadaArr + f * freqStride;
+        const float *im = re + mGpuHalfBlock;
+        for (int corr=0; corr<mNCorr; corr++) {
+            outArr[0] = re[plan[corr].offset];
+            outArr[1] = plan[corr].sign * im[plan[corr].offset];
+            outArr += 2;
+        }
+    }
 }
 
 int DadaReorder::simpleLineNum(const char *antName)
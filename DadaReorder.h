@@ -3,12 +3,21 @@
 
 #include <vector>
 #include <complex>
+#include <memory>
+#include "FlagMask.h"
+#include "ReorderKernels.h"
+#include "ThreadPool.h"
 
 namespace dada {
 
 class DadaReorder
 {
 public:
+    // A run of the raw input that sortData reads, in floats
+    struct InputRange {
+        size_t offset;
+        size_t length;
+    };
     DadaReorder(int nAnt, int nFreq, int nPol, int nCorr);
     ~DadaReorder();
     int nAnt() const {return mNAnt;};
@@ -17,31 +26,88 @@ public:
     int nPol() const {return mNPol;};
     int nCorr() const {return mNCorr;};
     int inputSize() const {return mGpuBaselines * mNFreq * mNCorr * 2;};
-    int outputSize() const {return mNBaseline * mNFreq * mNCorr;};
+    int outputSize() const {return nOutBaseline() * mNOutFreq * mNCorr;};
+    // Output selection. The output holds channels [firstFreq(), firstFreq() +
+    // nOutFreq()) of the baselines listed by outAnt1()/outAnt2().
+    void selectChannels(int firstFreq, int nFreq);
+    void selectBaselines(const std::vector<int> &ant1, const std::vector<int> &ant2);
+    void selectAutos();
+    bool autosOnly() const {return mAutosOnly;};
+    int firstFreq() const {return mFirstFreq;};
+    int nOutFreq() const {return mNOutFreq;};
+    int nOutBaseline() const {return mOutAnt1.size();};
+    const std::vector<int> &outAnt1() const {return mOutAnt1;};
+    const std::vector<int> &outAnt2() const {return mOutAnt2;};
+    const std::vector<InputRange> &inputRanges();
     void setLineMapping(int corrInput, int cable);
     void setLineMapping(const char *corrInput, const char *cable);
     int setLineMappingFromFile(const char *filename);
-    void applyGains(std::complex<float> *gains, char *gainFlags, char *outVisFlags);
-    void applyJones(std::complex<float> *jones, char *JonesFlags, char *outVisFlags);
-    void resetGains() {mApplyCal = false;};
-    void resetJones() {mApplyJones = false;};
-    void sortData(float *inArr, float *outArr);
+    void applyGains(const std::complex<float> *gains, const char *gainFlags);
+    void applyGains(const std::complex<float> *gains0, const char *gainFlags0, const std::complex<float> *gains1,
+                    const char *gainFlags1);
+    void setGainWeight(float weight) {mGainWeight = weight;};
+    void applyJones(const std::complex<float> *jones, const char *JonesFlags);
+    void resetGains();
+    void resetJones() {mApplyJones = false; mCalIsValid = false;};
+    bool flagsData() const {return mApplyCal || mApplyJones;};
+    // Flags of the output of the last sortData(), NULL when nothing is
+    // flagged. A new mask is made whenever the flags change, so a mask
+    // that has been handed out is never modified.
+    std::shared_ptr<const FlagMask> visFlags() const {return mVisFlags;};
+    void setNumThreads(int nThreads);
+    void sortData(const float *inArr, float *outArr);
     static int simpleLineNum(const char *antName);
 
 private:
-    bool mApplyCal, mApplyJones, mAutosOnly, mIndexIsValid;
+    // One entry per output correlation of a baseline. The raw value for
+    // frequency f is at offset + f * mGpuBaselines * mNCorr (real) and a
+    // further mGpuHalfBlock on (imaginary).
+    struct GatherEntry {
+        int offset;
+        float sign;  // Sign applied to the imaginary part (conjugation)
+    };
+
+    bool mApplyCal, mApplyJones, mAutosOnly, mIndexIsValid, mCalIsValid;
     const int mNAnt, mNFreq, mNPol, mNCorr, mNBaseline;
     const int mGpuBaselines, mGpuHalfBlock; // Larger than nBaselines due to alignment
+    int mFirstFreq, mNOutFreq;            // Selected channel range
     int * const mLineMap; // Defines physically remapped lines. Eg, line X could be connected to correlator input Y
     std::vector<std::vector<int> > mBaselineIndex;
     std::vector<std::vector<int> > mConjBaseline;
-    std::complex<float> *mGains;      // size MUST be nAnt * nFreq * nPol
-    std::complex<float> *mJones;      // size MUST be nAnt * nFreq * nPol * nPol
+    std::vector<GatherEntry> mGatherPlan; // [outBaseline][corr], built by buildIndex()
+    std::vector<int> mOutAnt1, mOutAnt2;  // Antennas of each output baseline
+    std::vector<InputRange> mInputRanges; // Parts of the input used by the gather plan
+    std::vector<char> mRunPattern;        // RunPattern of each output baseline
+    GatherRunKernel mGatherKernel;        // Vectorised gather for RUN_IDENTITY/RUN_TRANSPOSED baselines
+    ComplexMulKernel mMulKernel;          // Applies the gain products
+    JonesKernel mJonesKernel;             // Full or diagonal, chosen by applyJones()
+    // g0 * conj(g1) for each output visibility, [outBaseline][outFreq][corr],
+    // for a single gain solution. Built by buildCalPlan().
+    std::vector<std::complex<float> > mCalProduct;
+    bool mProductIsValid;
+    float mGainWeight;                    // Interpolation weight of the second solution
+    // Gains interpolated between the two solutions, [ant][freq][pol], and the
+    // weight they are for (-1 => not built)
+    std::vector<std::complex<float> > mInterpGains;
+    float mInterpWeight;
+    ThreadPool *mPool;                    // NULL when sorting on the calling thread only
+    const std::complex<float> *mGains[2]; // size MUST be nAnt * nFreq * nPol, mGains[1] may be NULL
+    const std::complex<float> *mJones;    // size MUST be nAnt * nFreq * nPol * nPol
     // These are char instead of bool to be compatible with std::vector
-    char *mGainFlags;                 // size MUST be nAnt * nFreq * nPol
-    char *mJonesFlags;                // size MUST be nAnt * nFreq
-    char *mOutVisFlags;               // size MUST be nBaseline * nFreq * nCorr
+    const char *mGainFlags[2];            // size MUST be nAnt * nFreq * nPol
+    const char *mJonesFlags;              // size MUST be nAnt * nFreq
+    std::shared_ptr<const FlagMask> mVisFlags; // Built by buildCalPlan()
     void buildIndex();
+    void buildGatherPlan();
+    void buildInputRanges();
+    void buildCalPlan();
+    void buildCalProduct();
+    void interpolateGains();
+    void interpolatedProduct(int baseline, int firstFreq, int lastFreq, std::complex<float> *product) const;
+    void selectAllBaselines();
+    void sortRange(const float *dadaArr, float *outArr, int firstBaseline, int lastBaseline,
+                   int firstFreq, int lastFreq);
+    void gatherBaseline(const float *dadaArr, int baseline, int firstFreq, int lastFreq, float *outArr) const;
 };
 
 } // namespace dada
@@ -0,0 +1,280 @@
+#include "DirectDadaFile.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dada {
+
+// O_DIRECT needs the buffer, offset and length aligned to the logical block
+// size of the device. 4096 covers all current disks.
+static const size_t directAlignment = 4096;
+
+static std::runtime_error ioError(const char *what)
+{
+    return std::runtime_error(std::string(what) + " in DirectDadaFile: " + strerror(errno));
+}
+
+DirectDadaFile::DirectDadaFile(const char *filename, size_t requestBytes, int nInFlight) :
+    mFd(-1), mFileSize(0), mDirect(true), mHead(0), mNextStart(0)
+#ifndef HAVE_LIBURING
+    , mStop(false)
+#endif
+{
+    if (nInFlight < 1 || requestBytes == 0)
+        throw std::invalid_argument("DirectDadaFile needs at least one non-empty request in flight");
+    mRequestBytes = (requestBytes + directAlignment - 1) / directAlignment * directAlignment;
+    mFd = open(filename, O_RDONLY | O_DIRECT);
+    if (mFd < 0 && errno == EINVAL) {
+        // Filesystem without O_DIRECT (e.g. tmpfs). Read through the page
+        // cache and drop our pages after use instead.
+        mDirect = false;
+        mFd = open(filename, O_RDONLY);
+        if (mFd >= 0)
+            posix_fadvise(mFd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+    if (mFd < 0)
+        throw ioError("Error opening dada file");
+    struct stat st;
+    if (fstat(mFd, &st) != 0) {
+        close(mFd);
+        throw ioError("Error reading dada file size");
+    }
+    mFileSize = st.st_size;
+#ifdef HAVE_LIBURING
+    int err = io_uring_queue_init(nInFlight, &mRing, 0);
+    if (err < 0) {
+        close(mFd);
+        errno = -err;
+        throw ioError("Error creating io_uring");
+    }
+#endif
+    mBlocks.resize(nInFlight);
+    for (size_t i=0; i<mBlocks.size(); ++i) {
+        void *data;
+        if (posix_memalign(&data, directAlignment, mRequestBytes) != 0) {
+            for (size_t j=0; j<i; ++j)
+                free(mBlocks[j].data);
+            close(mFd);
+            throw std::bad_alloc();
+        }
+        mBlocks[i].data = static_cast<char *>(data);
+        mBlocks[i].start = 0;
+        mBlocks[i].valid = 0;
+        mBlocks[i].pending = false;
+        mBlocks[i].async = false;
+        mBlocks[i].error = 0;
+    }
+    // Nothing is submitted until the first read() says where to start
+    mNextStart = mFileSize;
+    for (size_t i=0; i<mBlocks.size(); ++i)
+        mBlocks[i].start = mFileSize;
+#ifndef HAVE_LIBURING
+    mReader = std::thread(&DirectDadaFile::readerLoop, this);
+#endif
+}
+
+DirectDadaFile::~DirectDadaFile()
+{
+    for (size_t i=0; i<mBlocks.size(); ++i) {
+        try {
+            wait(mBlocks[i]);
+        } catch (const std::exception &) {
+            // Nothing useful to do with errors here
+        }
+    }
+#ifdef HAVE_LIBURING
+    io_uring_queue_exit(&mRing);
+#else
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mQueued.notify_one();
+    mReader.join();
+#endif
+    for (size_t i=0; i<mBlocks.size(); ++i)
+        free(mBlocks[i].data);
+    close(mFd);
+}
+
+const char *DirectDadaFile::engine() const
+{
+#ifdef HAVE_LIBURING
+    return "io_uring";
+#else
+    return "pread thread";
+#endif
+}
+
+// Copy [offset, offset+length) of the file to dest. Sequential calls are
+// served from the requests already in flight.
+void DirectDadaFile::read(size_t offset, size_t length, char *dest)
+{
+    if (offset + length > mFileSize)
+        throw std::runtime_error("Read Error in DirectDadaFile::read() (file truncated)");
+    Block *head = &mBlocks[mHead];
+    if (offset < head->start || offset >= head->start + mRequestBytes)
+        reset(offset);
+    while (length > 0) {
+        Block &block = mBlocks[mHead];
+        wait(block);
+        size_t inBlock = offset - block.start;
+        if (inBlock >= block.valid)
+            throw std::runtime_error("Read Error in DirectDadaFile::read() (short read)");
+        size_t n = std::min(length, block.valid - inBlock);
+        memcpy(dest, block.data + inBlock, n);
+        dest += n;
+        offset += n;
+        length -= n;
+        if (offset >= block.start + mRequestBytes) {
+            // Block used up, reuse it for the next request in the file
+            submit(block, mNextStart);
+            mNextStart += mRequestBytes;
+            mHead = (mHead + 1) % mBlocks.size();
+        }
+    }
+}
+
+// Restart the stream of requests at the aligned block containing offset.
+void DirectDadaFile::reset(size_t offset)
+{
+    for (size_t i=0; i<mBlocks.size(); ++i)
+        wait(mBlocks[i]);
+    mHead = 0;
+    mNextStart = offset - offset % directAlignment;
+    for (size_t i=0; i<mBlocks.size(); ++i) {
+        submit(mBlocks[i], mNextStart);
+        mNextStart += mRequestBytes;
+    }
+}
+
+void DirectDadaFile::submit(Block &block, size_t start)
+{
+    block.start = start;
+    block.valid = 0;
+    if (start >= mFileSize)
+        return;
+    block.pending = true;
+#ifdef HAVE_LIBURING
+    struct io_uring_sqe *sqe = io_uring_get_sqe(&mRing);
+    if (sqe == NULL) {
+        // Queue full, the request will be made synchronously by wait()
+        return;
+    }
+    io_uring_prep_read(sqe, mFd, block.data, mRequestBytes, start);
+    io_uring_sqe_set_data(sqe, &block);
+    int err = io_uring_submit(&mRing);
+    if (err < 0) {
+        errno = -err;
+        throw ioError("Error submitting read");
+    }
+    block.async = true;
+#else
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        block.async = true;
+        mQueue.push_back(&block);
+    }
+    mQueued.notify_one();
+#endif
+}
+
+#ifndef HAVE_LIBURING
+// Make the submitted requests in order, until the destructor stops it.
+void DirectDadaFile::readerLoop()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mQueued.wait(lock, [this] {return mStop || !mQueue.empty();});
+        if (mQueue.empty())
+            return;
+        Block *block = mQueue.front();
+        mQueue.pop_front();
+        lock.unlock();
+        const int error = readRemainder(*block);
+        lock.lock();
+        block->error = error;
+        block->async = false;
+        mDone.notify_all();
+    }
+}
+#endif
+
+void DirectDadaFile::wait(Block &block)
+{
+#ifdef HAVE_LIBURING
+    // Completions arrive in any order, so keep reaping until this one is in
+    while (block.async) {
+        struct io_uring_cqe *cqe;
+        int err = io_uring_wait_cqe(&mRing, &cqe);
+        if (err < 0) {
+            errno = -err;
+            throw ioError("Error waiting for read");
+        }
+        Block *done = static_cast<Block *>(io_uring_cqe_get_data(cqe));
+        int res = cqe->res;
+        io_uring_cqe_seen(&mRing, cqe);
+        done->async = false;
+        if (res < 0) {
+            done->pending = false;
+            errno = -res;
+            throw ioError("Read Error");
+        }
+        done->valid = res;
+        finish(*done);
+    }
+#else
+    {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mDone.wait(lock, [&block] {return !block.async;});
+    }
+    if (block.error != 0) {
+        block.pending = false;
+        errno = block.error;
+        block.error = 0;
+        throw ioError("Read Error");
+    }
+#endif
+    if (block.pending)
+        finish(block);
+}
+
+// Complete a request synchronously: the whole request if io_uring had no
+// room for it, or the remainder after a short read.
+void DirectDadaFile::finish(Block &block)
+{
+    const int error = readRemainder(block);
+    block.pending = false;
+    if (error != 0) {
+        errno = error;
+        throw ioError("Read Error");
+    }
+    if (!mDirect)
+        posix_fadvise(mFd, block.start, block.valid, POSIX_FADV_DONTNEED);
+}
+
+// pread() the rest of a request, returning 0 or the errno of a failure. This
+// is also the reader thread's read, so it only touches the block.
+int DirectDadaFile::readRemainder(Block &block)
+{
+    size_t wanted = std::min(mRequestBytes, mFileSize - block.start);
+    while (block.valid < wanted) {
+        ssize_t n = pread(mFd, block.data + block.valid, mRequestBytes - block.valid, block.start + block.valid);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n < 0)
+            return errno;
+        if (n == 0)
+            break;
+        block.valid += n;
+    }
+    return 0;
+}
+
+} // namespace dada
@@ -0,0 +1,68 @@
+#ifndef DIRECTDADAFILE_H_
+#define DIRECTDADAFILE_H_
+
+#include <cstddef>
+#include <vector>
+
+#ifdef HAVE_LIBURING
+#include <liburing.h>
+#else
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#endif
+
+namespace dada {
+
+// Sequential reader for dada files that are not in the page cache. The file
+// is opened with O_DIRECT (when the filesystem allows it) and read in large
+// aligned requests, several of which are kept in flight ahead of the
+// consumer. The requests go through io_uring when built with HAVE_LIBURING
+// (link with -luring), otherwise a reader thread makes them in order with
+// pread(), so either way they overlap with the work on the data already read.
+class DirectDadaFile
+{
+public:
+    DirectDadaFile(const char *filename, size_t requestBytes, int nInFlight);
+    ~DirectDadaFile();
+    void read(size_t offset, size_t length, char *dest);
+    size_t size() const {return mFileSize;};
+    bool isDirect() const {return mDirect;};
+    const char *engine() const;
+private:
+    struct Block {
+        char *data;
+        size_t start;  // File offset of data[0]
+        size_t valid;  // Bytes read so far
+        bool pending;  // Submitted but not yet waited for
+        bool async;    // With io_uring or the reader thread and not yet completed
+        int error;     // errno of a failed read by the reader thread
+    };
+    int mFd;
+    size_t mFileSize, mRequestBytes;
+    bool mDirect;
+    std::vector<Block> mBlocks; // Ring of requests in file order, starting at mHead
+    size_t mHead, mNextStart;
+#ifdef HAVE_LIBURING
+    struct io_uring mRing;
+#else
+    std::mutex mMutex;
+    std::condition_variable mQueued, mDone;
+    std::deque<Block *> mQueue; // Submitted blocks for the reader thread, in order
+    bool mStop;
+    std::thread mReader;
+    void readerLoop();
+#endif
+    DirectDadaFile(const DirectDadaFile &);
+    DirectDadaFile &operator=(const DirectDadaFile &);
+    void reset(size_t offset);
+    void submit(Block &block, size_t start);
+    void wait(Block &block);
+    void finish(Block &block);
+    int readRemainder(Block &block);
+};
+
+} // namespace dada
+
+#endif // DIRECTDADAFILE_H_
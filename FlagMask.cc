@@ -0,0 +1,30 @@
+#include "FlagMask.h"
+#include <cstring>
+
+namespace dada {
+
+bool FlagMask::any() const
+{
+    for (size_t w=0; w<mWords.size(); ++w) {
+        if (mWords[w] != 0)
+            return true;
+    }
+    return false;
+}
+
+void FlagMask::unpack(bool *flags) const
+{
+    for (size_t w=0; w<mWords.size(); ++w) {
+        const size_t first = w * 64;
+        const size_t n = mSize - first < 64 ? mSize - first : 64;
+        // Most of the data is normally unflagged
+        if (mWords[w] == 0) {
+            memset(flags + first, 0, n * sizeof(bool));
+        } else {
+            for (size_t b=0; b<n; ++b)
+                flags[first + b] = (mWords[w] >> b) & 1;
+        }
+    }
+}
+
+} // namespace dada
@@ -0,0 +1,31 @@
+#ifndef FLAGMASK_H_
+#define FLAGMASK_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace dada {
+
+// One bit per visibility, in the order of the sorted data
+// ([baseline][freq][corr]). Flags only change with the calibration, so a
+// mask is built once per calibration state and then shared, unchanged, by
+// every integration sorted with it.
+class FlagMask
+{
+public:
+    explicit FlagMask(size_t size) : mSize(size), mWords((size + 63) / 64, 0) {}
+    size_t size() const {return mSize;};
+    bool operator[](size_t i) const {return (mWords[i >> 6] >> (i & 63)) & 1;};
+    void set(size_t i) {mWords[i >> 6] |= static_cast<uint64_t>(1) << (i & 63);};
+    bool any() const;
+    // Expand into one bool per visibility, eg a casacore Cube<Bool>
+    void unpack(bool *flags) const;
+private:
+    size_t mSize;
+    std::vector<uint64_t> mWords;
+};
+
+} // namespace dada
+
+#endif // FLAGMASK_H_
@@ -0,0 +1,181 @@
+/*
+ * IntegrationWriter.cc
+ */
+
+#include "IntegrationWriter.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace casa;
+
+namespace dada2ms {
+
+// The first nRow rows (last axis) of a buffer
+template <typename T>
+static Array<T> firstRows(Array<T> &buffer, int nRow)
+{
+    IPosition end = buffer.shape() - 1;
+    end(end.nelements() - 1) = nRow - 1;
+    return buffer(IPosition(buffer.ndim(), 0), end);
+}
+
+// Rows [first, first + n) of a buffer
+template <typename T>
+static Array<T> rowRange(Array<T> &buffer, int first, int n)
+{
+    IPosition start(buffer.ndim(), 0);
+    IPosition end = buffer.shape() - 1;
+    start(start.nelements() - 1) = first;
+    end(end.nelements() - 1) = first + n - 1;
+    return buffer(start, end);
+}
+
+IntegrationWriter::IntegrationWriter(MeasurementSet &ms, const Vector<Int> &ant1, const Vector<Int> &ant2,
+                                     int nFreq, int nCorr, int batch, bool unitWeights, bool writeUvw,
+                                     bool wtSpec) :
+    mMs(ms),
+    mCols(ms),
+    mNBaseline(ant1.nelements()),
+    mNFreq(nFreq),
+    mNCorr(nCorr),
+    mBatch(batch),
+    mUnitWeights(unitWeights),
+    mWtSpec(wtSpec),
+    mWriteUvw(writeUvw),
+    mDataDescId(0),
+    mMeasureDataError(false),
+    mMaxDataError(0),
+    mMaxRelDataError(0),
+    mNBuffered(0)
+{
+    const int nRow = mNBaseline * mBatch;
+    const IPosition visShape(3, mNCorr, mNFreq, nRow);
+    // With one integration a batch, add() uses the caller's DATA, FLAG and
+    // UVW arrays in place
+    if (mBatch > 1) {
+        mData.resize(visShape);
+        mFlag.resize(visShape);
+        if (mWriteUvw)
+            mUvw.resize(IPosition(2, 3, nRow));
+    }
+    mWeight.resize(IPosition(2, mNCorr, nRow));
+    mWeight = 1.0f;
+    mSigma.resize(IPosition(2, mNCorr, nRow));
+    mSigma = 1.0f;
+    if (mWtSpec) {
+        mWeightSpectrum.resize(visShape);
+        mWeightSpectrum = 1.0f;
+    }
+    // The columns that are the same for every integration
+    mAnt1.resize(nRow);
+    mAnt2.resize(nRow);
+    for (int k=0; k<mBatch; ++k) {
+        mAnt1(Slice(k * mNBaseline, mNBaseline)) = ant1;
+        mAnt2(Slice(k * mNBaseline, mNBaseline)) = ant2;
+    }
+    mFieldId.resize(nRow);
+    mScan.resize(nRow);
+    mTime.resize(nRow);
+    mTimeCentroid.resize(nRow);
+    mInterval.resize(nRow);
+    mExposure.resize(nRow);
+}
+
+void IntegrationWriter::add(const Array<Complex> &data, const Array<Bool> &flag, const Array<Double> &uvw,
+                            const Array<Float> &weight, const Array<Float> &sigma,
+                            const Array<Float> &weightSpectrum,
+                            double time, double timeCentroid, double interval, double exposure,
+                            int fieldId, int scan)
+{
+    const int first = mNBuffered * mNBaseline;
+    if (mBatch == 1) {
+        mData.reference(data);
+        mFlag.reference(flag);
+        if (mWriteUvw)
+            mUvw.reference(uvw);
+    } else {
+        rowRange(mData, first, mNBaseline) = data;
+        rowRange(mFlag, first, mNBaseline) = flag;
+        if (mWriteUvw)
+            rowRange(mUvw, first, mNBaseline) = uvw;
+    }
+    if (!mUnitWeights) {
+        rowRange(mWeight, first, mNBaseline) = weight;
+        rowRange(mSigma, first, mNBaseline) = sigma;
+        if (mWtSpec)
+            rowRange(mWeightSpectrum, first, mNBaseline) = weightSpectrum;
+    }
+    const Slice rows(first, mNBaseline);
+    mFieldId(rows) = fieldId;
+    mScan(rows) = scan;
+    mTime(rows) = time;
+    mTimeCentroid(rows) = timeCentroid;
+    mInterval(rows) = interval;
+    mExposure(rows) = exposure;
+    if (++mNBuffered == mBatch)
+        flush();
+}
+
+void IntegrationWriter::flush()
+{
+    if (mNBuffered == 0)
+        return;
+    const int nRow = mNBuffered * mNBaseline;
+    // The table grows a batch at a time, so a failed run leaves only the
+    // rows of the batch being written unfilled
+    const uInt first = mMs.nrow();
+    mMs.addRow(nRow);
+    const Slicer rows(IPosition(1, first), IPosition(1, nRow));
+    const Slice batch(0, nRow);
+
+    if (mWriteUvw)
+        mCols.uvw().putColumnRange(rows, firstRows(mUvw, nRow));
+    mCols.flag().putColumnRange(rows, firstRows(mFlag, nRow));
+    mCols.weight().putColumnRange(rows, firstRows(mWeight, nRow));
+    mCols.sigma().putColumnRange(rows, firstRows(mSigma, nRow));
+    mCols.antenna1().putColumnRange(rows, mAnt1(batch));
+    mCols.antenna2().putColumnRange(rows, mAnt2(batch));
+    mCols.dataDescId().putColumnRange(rows, Vector<Int>(nRow, mDataDescId));
+    mCols.exposure().putColumnRange(rows, mExposure(batch));
+    mCols.fieldId().putColumnRange(rows, mFieldId(batch));
+    mCols.interval().putColumnRange(rows, mInterval(batch));
+    mCols.scanNumber().putColumnRange(rows, mScan(batch));
+    mCols.time().putColumnRange(rows, mTime(batch));
+    mCols.timeCentroid().putColumnRange(rows, mTimeCentroid(batch));
+    const Array<Complex> data = firstRows(mData, nRow);
+    mCols.data().putColumnRange(rows, data);
+    if (mMeasureDataError)
+        measureDataError(data, rows);
+    if (mWtSpec)
+        mCols.weightSpectrum().putColumnRange(rows, firstRows(mWeightSpectrum, nRow));
+    mNBuffered = 0;
+}
+
+// Track the largest difference between the data of a batch and what was
+// stored for them, absolute and relative to the largest real or imaginary
+// part of each row
+void IntegrationWriter::measureDataError(const Array<Complex> &data, const Slicer &rows)
+{
+    const Array<Complex> stored = mCols.data().getColumnRange(rows);
+    const size_t rowSize = mNCorr * mNFreq;
+    Bool delData, delStored;
+    const Complex *d = data.getStorage(delData);
+    const Complex *s = stored.getStorage(delStored);
+    for (size_t row=0; row<data.nelements()/rowSize; ++row) {
+        double peak = 0, error = 0;
+        for (size_t k=row*rowSize; k<(row+1)*rowSize; ++k) {
+            if (!isFinite(d[k].real()) || !isFinite(d[k].imag()))
+                continue;
+            peak = std::max<double>(peak, std::max(std::abs(d[k].real()), std::abs(d[k].imag())));
+            error = std::max<double>(error, std::max(std::abs(s[k].real() - d[k].real()),
+                                                     std::abs(s[k].imag() - d[k].imag())));
+        }
+        mMaxDataError = std::max(mMaxDataError, error);
+        if (peak > 0)
+            mMaxRelDataError = std::max(mMaxRelDataError, error / peak);
+    }
+    data.freeStorage(d, delData);
+    stored.freeStorage(s, delStored);
+}
+
+} // namespace dada2ms
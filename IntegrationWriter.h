@@ -0,0 +1,74 @@
+/*
+ * IntegrationWriter.h
+ */
+
+#ifndef INTEGRATIONWRITER_H_
+#define INTEGRATIONWRITER_H_
+
+// casacore headers
+#include <casa/Arrays.h>
+#include <ms/MeasurementSets.h>
+
+namespace dada2ms {
+
+// Writes integrations to the main table of an MS a batch at a time. The
+// values of every column for the batch are gathered into contiguous arrays,
+// then the rows are added and each column is written with one put covering
+// the whole batch, so casacore's per-put work (slicer, locking, storage
+// manager lookup) is done once per column per batch rather than once per
+// column per integration.
+// IncrementalStMan columns are written like the others; that manager only
+// stores the values that differ from the previous row.
+class IntegrationWriter
+{
+public:
+    // Integrations have the baselines ant1-ant2. With unitWeights WEIGHT,
+    // SIGMA and WEIGHT_SPECTRUM are 1, otherwise they are given to add().
+    // writeUvw and wtSpec write UVW and WEIGHT_SPECTRUM.
+    IntegrationWriter(casa::MeasurementSet &ms, const casa::Vector<casa::Int> &ant1,
+                      const casa::Vector<casa::Int> &ant2, int nFreq, int nCorr, int batch,
+                      bool unitWeights, bool writeUvw, bool wtSpec);
+    void setDataDescId(int id) {mDataDescId = id;};
+    // Read back the DATA of each batch to find the largest compression error
+    void setMeasureDataError(bool measure) {mMeasureDataError = measure;};
+    // Buffer an integration, writing the batch once it is full. data, flag
+    // and weightSpectrum are [baseline][freq][corr], uvw [baseline][3] and
+    // weight and sigma [baseline][corr]. time is the middle of the interval
+    // and timeCentroid the mean time of the samples in it. The arrays are
+    // only used during the call.
+    void add(const casa::Array<casa::Complex> &data, const casa::Array<casa::Bool> &flag,
+             const casa::Array<casa::Double> &uvw,
+             const casa::Array<casa::Float> &weight, const casa::Array<casa::Float> &sigma,
+             const casa::Array<casa::Float> &weightSpectrum,
+             double time, double timeCentroid, double interval, double exposure, int fieldId, int scan);
+    // Write any buffered integrations
+    void flush();
+    int nBuffered() const {return mNBuffered;};
+    // Largest difference between the data given and those read back, and
+    // that relative to the largest real or imaginary part of the row
+    double maxDataError() const {return mMaxDataError;};
+    double maxRelDataError() const {return mMaxRelDataError;};
+private:
+    casa::MeasurementSet &mMs;
+    casa::MSMainColumns mCols;
+    const int mNBaseline, mNFreq, mNCorr, mBatch;
+    const bool mUnitWeights, mWtSpec, mWriteUvw;
+    int mDataDescId;
+    bool mMeasureDataError;
+    double mMaxDataError, mMaxRelDataError;
+    int mNBuffered;
+    // [row][...] for mBatch integrations of rows
+    casa::Array<casa::Complex> mData;
+    casa::Array<casa::Bool> mFlag;
+    casa::Array<casa::Float> mWeight, mSigma, mWeightSpectrum;
+    casa::Array<casa::Double> mUvw;
+    casa::Vector<casa::Int> mAnt1, mAnt2, mFieldId, mScan;
+    casa::Vector<casa::Double> mTime, mTimeCentroid, mInterval, mExposure;
+    void measureDataError(const casa::Array<casa::Complex> &data, const casa::Slicer &rows);
+    IntegrationWriter(const IntegrationWriter &);
+    IntegrationWriter &operator=(const IntegrationWriter &);
+};
+
+} // namespace dada2ms
+
+#endif /* INTEGRATIONWRITER_H_ */
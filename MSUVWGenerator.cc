@@ -8,6 +8,9 @@
 #include <ms/MeasurementSets/MSColumns.h>
 #include <ms/MeasurementSets/MSAntennaColumns.h>
 #include <measures/Measures/MCBaseline.h>
+#include <algorithm>
+#include <map>
+#include <utility>
 
 namespace casa {
 
@@ -142,76 +145,129 @@ void MSUVWGenerator::uvw_bl(const uInt ant1, const uInt,// feed1,
 {
   //uvw.resize(3);      // Probably redundant.  Does it significantly slow things down?
   //TODO: Feed offsets are not handled yet.
-  uvw = antUVW_p[ant2] - antUVW_p[ant1];
+  // dada2ms conjugates the visibilities for ant1 - ant2 (as zenithUVWs and
+  // UVWEngine do), the opposite of casacore's ant2 - ant1.
+  uvw = antUVW_p[ant1] - antUVW_p[ant2];
 }
 
 Bool MSUVWGenerator::make_uvws(const Vector<Int> flds)
 {
   ArrayColumn<Double>&      UVWcol   = msc_p.uvw();  
   const ScalarMeasColumn<MEpoch>& timeCentMeas = msc_p.timeCentroidMeas();
-  const ROScalarColumn<Int> fieldID(msc_p.fieldId());
-  const ROScalarColumn<Int> ant1(msc_p.antenna1());
-  const ROScalarColumn<Int> ant2(msc_p.antenna2());
-  const ROScalarColumn<Int> feed1(msc_p.feed1());
-  const ROScalarColumn<Int> feed2(msc_p.feed2());
-  const ROScalarColumn<Int> obsID(msc_p.observationId());
-
-  // Use a time ordered index to minimize the number of calls to uvw_an.
-  // TODO: use field as a secondary sort key.
-  Vector<uInt> tOI;
-  GenSortIndirect<Double>::sort(tOI, msc_p.timeCentroid().getColumn());
-
-  // Having uvw_an() calculate positions for each antenna for every field is
-  // somewhat inefficient since in a multiconfig MS not all antennas will be
-  // used in each time interval, but it's not clear that determining which
-  // antennas will be used for a given uvw_an() call would be any more
-  // efficient.  It's not horribly inefficient, because uvw_an() is O(nant_p),
-  // and uvw_bl() is only called for baselines that are actually used.
+  const uInt nrow = msc_p.nrow();
+  if(nrow == 0)
+    return true;
+
+  // Compare the telescope names once per observation, not once per row.
+  const ROScalarColumn<String>& telescopeName = msc_p.observation().telescopeName();
+  Vector<Bool> wsrtConvention(telescopeName.nrow());
+  for(uInt obs = 0; obs < wsrtConvention.nelements(); ++obs)
+    wsrtConvention[obs] = telescopeName(obs) == "WSRT";
+
   antUVW_p.resize(nant_p);
 
   logSink() << LogOrigin("MSUVWGenerator", "make_uvws") << LogIO::NORMAL3;
   
   logSink() << LogIO::DEBUG1 << "timeRes_p: " << timeRes_p << LogIO::POST;
 
+  // The antenna UVWs ([antenna][3]) calculated recently for each (field,
+  // convention), by the time they were calculated for.  As when the rows
+  // were sorted by time, a row uses the antenna UVWs of the latest time
+  // that is no more than timeRes_p before its own.  The rows of an
+  // integration share a time, and MSs are mostly in time order, so the
+  // cache only has to hold the fields of the current times; it is emptied
+  // when it grows past maxCached.  This replaces sorting the whole MS by
+  // time.
+  typedef std::pair<Int, Bool> UVWKey;
+  typedef std::map<Double, Matrix<Double> > TimeCache;
+  std::map<UVWKey, TimeCache> antUVWCache;
+  size_t nCached = 0;
+  const size_t maxCached = 256;
+  Bool sawWsrt = false;
+  Bool sawOther = false;
+
+  // The MS is worked through in blocks of contiguous rows, reading the
+  // columns that select each row's antenna UVWs and writing UVW a block at
+  // a time, so memory use does not grow with the MS.
+  const uInt blockRows = 65536;
+  Vector<Double> timeCent;
+  Vector<Int> fieldID, ant1, ant2, obsID;
+  Matrix<Double> uvwBlock;
+
   try{
-    Bool oldWsrtConvention = (msc_p.observation().telescopeName()(obsID(tOI[0])) ==
-                              "WSRT");
-
-    // Ensure a call to uvw_an on the 1st iteration.
-    const Unit sec("s");
-    Double oldTime = timeCentMeas(tOI[0]).get(sec).getValue() - 2.0 * timeRes_p;
-    Int    oldFld  = -2;
-    for(uInt row = 0; row < msc_p.nrow(); ++row){
-      uInt   toir = tOI[row];
-      Double currTime = timeCentMeas(toir).get(sec).getValue();
-      Int    currFld  = fieldID(toir);
-      Bool   newWsrtConvention = (msc_p.observation().telescopeName()(obsID(toir)) ==
-                                  "WSRT");
-
-      if(currTime - oldTime > timeRes_p || currFld != oldFld
-         || newWsrtConvention != oldWsrtConvention){
-        oldTime = currTime;
-        oldFld  = currFld;
-
-        if(newWsrtConvention != oldWsrtConvention){
-          logSink() << LogIO::WARN
-                    << "There is a switch to or from the WSRT convention at row "
-                    << toir << ".\nWatch for an inconsistency in the sign of UVW."
-                    << LogIO::POST;
-          oldWsrtConvention = newWsrtConvention;
+    for(uInt start = 0; start < nrow; start += blockRows){
+      const uInt n = std::min(blockRows, nrow - start);
+      const Slicer rows(IPosition(1, start), IPosition(1, n));
+      msc_p.timeCentroid().getColumnRange(rows, timeCent, true);
+      msc_p.fieldId().getColumnRange(rows, fieldID, true);
+      msc_p.antenna1().getColumnRange(rows, ant1, true);
+      msc_p.antenna2().getColumnRange(rows, ant2, true);
+      msc_p.observationId().getColumnRange(rows, obsID, true);
+
+      // Rows of fields that are not being recalculated keep their UVWs.
+      Bool allSelected = true;
+      for(uInt i = 0; i < n && allSelected; ++i)
+        allSelected = flds[fieldID[i]] > -1;
+      if(allSelected)
+        uvwBlock.resize(3, n);
+      else
+        UVWcol.getColumnRange(rows, uvwBlock, true);
+
+      Bool deleteBlock;
+      Double *blockData = uvwBlock.getStorage(deleteBlock);
+      Double *out = blockData;
+      const Double *antUVW = NULL;
+      UVWKey lastKey;
+      Double lastTime = 0.0;
+      for(uInt i = 0; i < n; ++i, out += 3){
+        const Int currFld = fieldID[i];
+        if(flds[currFld] <= -1)
+          continue;
+        const Double currTime = timeCent[i];
+        const UVWKey key(currFld, wsrtConvention[obsID[i]]);
+        if(antUVW == NULL || key != lastKey || currTime < lastTime
+           || currTime - lastTime > timeRes_p){
+          TimeCache &times = antUVWCache[key];
+          TimeCache::iterator cached = times.upper_bound(currTime);
+          if(cached != times.begin())
+            --cached;
+          if(cached == times.end() || cached->first > currTime
+             || currTime - cached->first > timeRes_p){
+            if(nCached >= maxCached){
+              antUVWCache.clear();
+              nCached = 0;
+            }
+            logSink() << LogIO::DEBUG1 << "currTime: " << currTime
+                      << "\ncurrFld: " << currFld << LogIO::POST;
+            uvw_an(timeCentMeas(start + i), currFld, key.second);
+            Matrix<Double> antUVWs(3, nant_p);
+            for(uInt an = 0; an < nant_p; ++an)
+              antUVWs.column(an) = antUVW_p[an];
+            cached = antUVWCache[key].insert(std::make_pair(currTime, antUVWs)).first;
+            ++nCached;
+            if(key.second)
+              sawWsrt = true;
+            else
+              sawOther = true;
+          }
+          antUVW = cached->second.data();
+          lastKey = key;
+          lastTime = cached->first;
         }
-
-        logSink() << LogIO::DEBUG1 << "currTime: " << currTime
-                  << "\ncurrFld: " << currFld << LogIO::POST;
-        uvw_an(timeCentMeas(toir), currFld, newWsrtConvention);
-      }
-    
-      if(flds[fieldID(toir)] > -1){
-	//      uvw_bl(ant1(toir), ant2(toir),
-	//     feed1(toir), feed2(toir), UVWcol(toir));
-	UVWcol.put(toir, antUVW_p[ant2(toir)] - antUVW_p[ant1(toir)]);
+        const Double *uvw1 = antUVW + 3 * ant1[i];
+        const Double *uvw2 = antUVW + 3 * ant2[i];
+        out[0] = uvw1[0] - uvw2[0];
+        out[1] = uvw1[1] - uvw2[1];
+        out[2] = uvw1[2] - uvw2[2];
       }
+      uvwBlock.putStorage(blockData, deleteBlock);
+      UVWcol.putColumnRange(rows, uvwBlock);
     }
+    if(sawWsrt && sawOther)
+      logSink() << LogIO::WARN
+                << "Both the WSRT and the VLA UVW conventions were used."
+                << "\nWatch for an inconsistency in the sign of UVW."
+                << LogIO::POST;
   }
   catch(AipsError x){
     logSink() << LogIO::SEVERE << "Caught exception: " << x.getMesg() 
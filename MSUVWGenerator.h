@@ -103,7 +103,8 @@ public:
   //	   @param feed1  Row number in the FEED    table of the 1st feed.
   //	   @param ant1   Row number in the ANTENNA table of the 2nd antenna.
   //	   @param feed2  Row number in the FEED    table of the 2nd feed.
-  //       @param uvw    The returned UVW coordinates.
+  //       @param uvw    The returned UVW coordinates, those of ant1 less
+  //                     those of ant2.
   void uvw_bl(const uInt ant1, const uInt feed1,
               const uInt ant2, const uInt feed2, Array<Double>& uvw);
 
@@ -114,6 +115,9 @@ public:
   //       		     5 fields, and the user wants to (re)calculate the
   //       		     UVWs of only 0, 2, and 4, phaseDirs will have 3
   //       		     entries and flds will be [0, -1, 1, -1, 2].  
+  //       The columns selecting each row's antenna UVWs are read whole, the
+  //       antenna UVWs are cached per (time, field), and UVW is written in
+  //       blocks of contiguous rows.
   Bool make_uvws(const Vector<Int> flds);
 private:
   // Sets up the antenna positions as baselines (bl_an_p), the number of
@@ -0,0 +1,65 @@
+#include "MappedDadaFile.h"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace dada {
+
+MappedDadaFile::MappedDadaFile(const char *filename) :
+    mData(NULL), mSize(0), mPageSize(sysconf(_SC_PAGESIZE))
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        throw std::runtime_error(std::string("Error opening dada file in MappedDadaFile: ") + strerror(errno));
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw std::runtime_error(std::string("Error reading dada file size in MappedDadaFile: ") + strerror(errno));
+    }
+    mSize = st.st_size;
+    void *addr = mmap(NULL, mSize, PROT_READ, MAP_SHARED, fd, 0);
+    // The mapping holds its own reference to the file
+    close(fd);
+    if (addr == MAP_FAILED)
+        throw std::runtime_error(std::string("Error mapping dada file in MappedDadaFile: ") + strerror(errno));
+    mData = static_cast<const char *>(addr);
+    // Integrations are normally read in order
+    advise(0, mSize, MADV_SEQUENTIAL);
+}
+
+MappedDadaFile::~MappedDadaFile()
+{
+    munmap(const_cast<char *>(mData), mSize);
+}
+
+// Start read-ahead of a range that is about to be used.
+void MappedDadaFile::willNeed(size_t offset, size_t length)
+{
+    advise(offset, length, MADV_WILLNEED);
+}
+
+// Drop a range that has been used from this process. The pages stay in the
+// page cache for other readers.
+void MappedDadaFile::dontNeed(size_t offset, size_t length)
+{
+    advise(offset, length, MADV_DONTNEED);
+}
+
+void MappedDadaFile::advise(size_t offset, size_t length, int advice)
+{
+    if (offset >= mSize)
+        return;
+    if (offset + length > mSize)
+        length = mSize - offset;
+    // madvise() needs a page aligned start
+    size_t start = offset - offset % mPageSize;
+    // Advice is only a hint, so failures are ignored
+    madvise(const_cast<char *>(mData) + start, length + offset - start, advice);
+}
+
+} // namespace dada
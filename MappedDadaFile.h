@@ -0,0 +1,30 @@
+#ifndef MAPPEDDADAFILE_H_
+#define MAPPEDDADAFILE_H_
+
+#include <cstddef>
+
+namespace dada {
+
+// Read-only memory map of a whole dada file, so chunks can be gathered
+// straight out of the page cache.
+class MappedDadaFile
+{
+public:
+    MappedDadaFile(const char *filename);
+    ~MappedDadaFile();
+    size_t size() const {return mSize;};
+    const char *data() const {return mData;};
+    void willNeed(size_t offset, size_t length);
+    void dontNeed(size_t offset, size_t length);
+private:
+    const char *mData;
+    size_t mSize;
+    size_t mPageSize;
+    MappedDadaFile(const MappedDadaFile &);
+    MappedDadaFile &operator=(const MappedDadaFile &);
+    void advise(size_t offset, size_t length, int advice);
+};
+
+} // namespace dada
+
+#endif // MAPPEDDADAFILE_H_
@@ -0,0 +1,517 @@
+#include "ReorderKernels.h"
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+// GCC 12's AVX-512 intrinsics pass _mm512_undefined_ps() to their builtins,
+// which -Wall reports as uninitialised wherever they are inlined (GCC bug
+// 105593). The warnings are located in the header, so are silenced there.
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#include <immintrin.h>
+#pragma GCC diagnostic pop
+#define DADA_X86_KERNELS
+#endif
+
+// The vectorised gather kernels only move data and multiply by +/-1, so they
+// give bit-identical results to gatherRunScalar. The arithmetic kernels do the
+// same operations in the same order as their scalar versions. Each is compiled
+// for its own instruction set with a target attribute, so the plain g++ build
+// line in the README still works and the choice is made at runtime.
+
+namespace dada {
+
+enum SimdLevel {SIMD_SCALAR, SIMD_SSE42, SIMD_AVX2, SIMD_AVX512};
+
+void gatherRunScalar(const float *re, const float *im, int freqStride,
+                     const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    const int identity[4] = {0, 1, 2, 3};
+    const int transposed[4] = {0, 2, 1, 3};
+    const int *p = (pattern == RUN_TRANSPOSED) ? transposed : identity;
+    for (int f=0; f<nFreq; f++) {
+        for (int c=0; c<4; c++) {
+            out[2*c] = re[p[c]];
+            out[2*c+1] = sign[c] * im[p[c]];
+        }
+        re += freqStride;
+        im += freqStride;
+        out += 8;
+    }
+}
+
+void complexMulScalar(const float *factor, float *data, int n)
+{
+    for (int k=0; k<n; k++) {
+        float fr = factor[2*k], fi = factor[2*k+1];
+        float dr = data[2*k], di = data[2*k+1];
+        data[2*k] = fr*dr - fi*di;
+        data[2*k+1] = fr*di + fi*dr;
+    }
+}
+
+// The Jones kernels work on the four correlations of a channel at once:
+//     M = J0 V       = A*V + B*swap(V)
+//     R = M J1^H     = M*C + swapPairs(M)*D
+// where * is elementwise, A = (a0, a0, d0, d0), B = (b0, b0, c0, c0),
+// C = conj(a1, d1, a1, d1), D = conj(b1, c1, b1, c1), swap exchanges the
+// XX/XY and YX/YY pairs and swapPairs exchanges XX/XY and YX/YY within each
+// pair. The vector versions permute whole registers to the same effect.
+static inline void cmul(const float *a, const float *b, float *out)
+{
+    out[0] = a[0]*b[0] - a[1]*b[1];
+    out[1] = a[0]*b[1] + a[1]*b[0];
+}
+
+void jonesScalar(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    static const int aIndex[4] = {0, 0, 3, 3}, bIndex[4] = {1, 1, 2, 2};
+    static const int cIndex[4] = {0, 3, 0, 3}, dIndex[4] = {1, 2, 1, 2};
+    static const int swap[4] = {2, 3, 0, 1}, swapPairs[4] = {1, 0, 3, 2};
+    for (int f=0; f<nFreq; f++) {
+        float j1c[8], m[8], p[2], q[2];
+        for (int k=0; k<4; k++) {
+            j1c[2*k] = j1[2*k];
+            j1c[2*k+1] = -j1[2*k+1];
+        }
+        for (int k=0; k<4; k++) {
+            cmul(j0 + 2*aIndex[k], vis + 2*k, p);
+            cmul(j0 + 2*bIndex[k], vis + 2*swap[k], q);
+            m[2*k] = p[0] + q[0];
+            m[2*k+1] = p[1] + q[1];
+        }
+        for (int k=0; k<4; k++) {
+            cmul(m + 2*k, j1c + 2*cIndex[k], p);
+            cmul(m + 2*swapPairs[k], j1c + 2*dIndex[k], q);
+            vis[2*k] = p[0] + q[0];
+            vis[2*k+1] = p[1] + q[1];
+        }
+        j0 += 8;
+        j1 += 8;
+        vis += 8;
+    }
+}
+
+// With diagonal matrices R = V * (a0, a0, d0, d0) * conj(a1, d1, a1, d1).
+void jonesDiagScalar(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    static const int aIndex[4] = {0, 0, 3, 3}, cIndex[4] = {0, 3, 0, 3};
+    for (int f=0; f<nFreq; f++) {
+        for (int k=0; k<4; k++) {
+            float c[2] = {j1[2*cIndex[k]], -j1[2*cIndex[k]+1]};
+            float p[2], v[2] = {vis[2*k], vis[2*k+1]};
+            cmul(j0 + 2*aIndex[k], c, p);
+            cmul(p, v, vis + 2*k);
+        }
+        j0 += 8;
+        j1 += 8;
+        vis += 8;
+    }
+}
+
+#ifdef DADA_X86_KERNELS
+
+__attribute__((target("sse4.2")))
+void gatherRunSSE42(const float *re, const float *im, int freqStride,
+                    const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    const __m128 s = _mm_loadu_ps(sign);
+    for (int f=0; f<nFreq; f++) {
+        __m128 r = _mm_loadu_ps(re);
+        __m128 i = _mm_loadu_ps(im);
+        if (pattern == RUN_TRANSPOSED) {
+            r = _mm_shuffle_ps(r, r, _MM_SHUFFLE(3, 1, 2, 0));
+            i = _mm_shuffle_ps(i, i, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        i = _mm_mul_ps(i, s);
+        _mm_storeu_ps(out, _mm_unpacklo_ps(r, i));
+        _mm_storeu_ps(out + 4, _mm_unpackhi_ps(r, i));
+        re += freqStride;
+        im += freqStride;
+        out += 8;
+    }
+}
+
+// Two frequencies per iteration, one in each 128 bit lane.
+__attribute__((target("avx2")))
+void gatherRunAVX2(const float *re, const float *im, int freqStride,
+                   const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    const __m128 s4 = _mm_loadu_ps(sign);
+    const __m256 s = _mm256_insertf128_ps(_mm256_castps128_ps256(s4), s4, 1);
+    int f = 0;
+    for (; f+2<=nFreq; f+=2) {
+        __m256 r = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(re)),
+                                        _mm_loadu_ps(re + freqStride), 1);
+        __m256 i = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(im)),
+                                        _mm_loadu_ps(im + freqStride), 1);
+        if (pattern == RUN_TRANSPOSED) {
+            r = _mm256_shuffle_ps(r, r, _MM_SHUFFLE(3, 1, 2, 0));
+            i = _mm256_shuffle_ps(i, i, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        i = _mm256_mul_ps(i, s);
+        __m256 lo = _mm256_unpacklo_ps(r, i);
+        __m256 hi = _mm256_unpackhi_ps(r, i);
+        _mm256_storeu_ps(out, _mm256_permute2f128_ps(lo, hi, 0x20));
+        _mm256_storeu_ps(out + 8, _mm256_permute2f128_ps(lo, hi, 0x31));
+        re += 2*freqStride;
+        im += 2*freqStride;
+        out += 16;
+    }
+    if (f < nFreq)
+        gatherRunSSE42(re, im, freqStride, sign, pattern, nFreq - f, out);
+}
+
+// Four frequencies per iteration, one in each 128 bit lane.
+__attribute__((target("avx512f")))
+void gatherRunAVX512(const float *re, const float *im, int freqStride,
+                     const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    const __m512 s = _mm512_broadcast_f32x4(_mm_loadu_ps(sign));
+    const __m512i first = _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 18, 19, 4, 5, 6, 7, 20, 21, 22, 23);
+    const __m512i second = _mm512_setr_epi32(8, 9, 10, 11, 24, 25, 26, 27, 12, 13, 14, 15, 28, 29, 30, 31);
+    int f = 0;
+    for (; f+4<=nFreq; f+=4) {
+        __m512 r = _mm512_zextps128_ps512(_mm_loadu_ps(re));
+        __m512 i = _mm512_zextps128_ps512(_mm_loadu_ps(im));
+        r = _mm512_insertf32x4(r, _mm_loadu_ps(re + freqStride), 1);
+        i = _mm512_insertf32x4(i, _mm_loadu_ps(im + freqStride), 1);
+        r = _mm512_insertf32x4(r, _mm_loadu_ps(re + 2*freqStride), 2);
+        i = _mm512_insertf32x4(i, _mm_loadu_ps(im + 2*freqStride), 2);
+        r = _mm512_insertf32x4(r, _mm_loadu_ps(re + 3*freqStride), 3);
+        i = _mm512_insertf32x4(i, _mm_loadu_ps(im + 3*freqStride), 3);
+        if (pattern == RUN_TRANSPOSED) {
+            r = _mm512_shuffle_ps(r, r, _MM_SHUFFLE(3, 1, 2, 0));
+            i = _mm512_shuffle_ps(i, i, _MM_SHUFFLE(3, 1, 2, 0));
+        }
+        i = _mm512_mul_ps(i, s);
+        __m512 lo = _mm512_unpacklo_ps(r, i);
+        __m512 hi = _mm512_unpackhi_ps(r, i);
+        _mm512_storeu_ps(out, _mm512_permutex2var_ps(lo, first, hi));
+        _mm512_storeu_ps(out + 16, _mm512_permutex2var_ps(lo, second, hi));
+        re += 4*freqStride;
+        im += 4*freqStride;
+        out += 32;
+    }
+    if (f < nFreq)
+        gatherRunSSE42(re, im, freqStride, sign, pattern, nFreq - f, out);
+}
+
+// Complex multiply of interleaved values: multiply by the duplicated real
+// parts, then add or subtract the swapped values times the imaginary parts.
+__attribute__((target("sse4.2")))
+void complexMulSSE42(const float *factor, float *data, int n)
+{
+    int k = 0;
+    for (; k+2<=n; k+=2) {
+        __m128 f = _mm_loadu_ps(factor + 2*k);
+        __m128 d = _mm_loadu_ps(data + 2*k);
+        __m128 re = _mm_mul_ps(_mm_moveldup_ps(f), d);
+        __m128 im = _mm_mul_ps(_mm_movehdup_ps(f), _mm_shuffle_ps(d, d, _MM_SHUFFLE(2, 3, 0, 1)));
+        _mm_storeu_ps(data + 2*k, _mm_addsub_ps(re, im));
+    }
+    complexMulScalar(factor + 2*k, data + 2*k, n - k);
+}
+
+__attribute__((target("avx2")))
+void complexMulAVX2(const float *factor, float *data, int n)
+{
+    int k = 0;
+    for (; k+4<=n; k+=4) {
+        __m256 f = _mm256_loadu_ps(factor + 2*k);
+        __m256 d = _mm256_loadu_ps(data + 2*k);
+        __m256 re = _mm256_mul_ps(_mm256_moveldup_ps(f), d);
+        __m256 im = _mm256_mul_ps(_mm256_movehdup_ps(f), _mm256_permute_ps(d, _MM_SHUFFLE(2, 3, 0, 1)));
+        _mm256_storeu_ps(data + 2*k, _mm256_addsub_ps(re, im));
+    }
+    complexMulSSE42(factor + 2*k, data + 2*k, n - k);
+}
+
+// AVX-512 has no addsub, so flip the sign of the even lanes and add. The add
+// is the explicitly rounded form so the compiler can't fuse it with the
+// multiply (AVX-512F includes FMA).
+__attribute__((target("avx512f")))
+void complexMulAVX512(const float *factor, float *data, int n)
+{
+    const __m512i evenSign = _mm512_set1_epi64(0x80000000LL);
+    int k = 0;
+    for (; k+8<=n; k+=8) {
+        __m512 f = _mm512_loadu_ps(factor + 2*k);
+        __m512 d = _mm512_loadu_ps(data + 2*k);
+        __m512 re = _mm512_mul_ps(_mm512_moveldup_ps(f), d);
+        __m512 im = _mm512_mul_ps(_mm512_movehdup_ps(f), _mm512_permute_ps(d, _MM_SHUFFLE(2, 3, 0, 1)));
+        im = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(im), evenSign));
+        _mm512_storeu_ps(data + 2*k, _mm512_add_round_ps(re, im, _MM_FROUND_CUR_DIRECTION));
+    }
+    complexMulSSE42(factor + 2*k, data + 2*k, n - k);
+}
+
+// One channel per register.
+__attribute__((target("avx2")))
+static inline __m256 cmul256(__m256 a, __m256 b)
+{
+    __m256 re = _mm256_mul_ps(_mm256_moveldup_ps(a), b);
+    __m256 im = _mm256_mul_ps(_mm256_movehdup_ps(a), _mm256_permute_ps(b, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm256_addsub_ps(re, im);
+}
+
+// imm is a template argument so that it is an immediate even without inlining
+template <int imm>
+__attribute__((target("avx2")))
+static inline __m256 permuteComplex256(__m256 x)
+{
+    return _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(x), imm));
+}
+
+__attribute__((target("avx2")))
+void jonesAVX2(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    const __m256 conjSign = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+    for (int f=0; f<nFreq; f++) {
+        __m256 v = _mm256_loadu_ps(vis);
+        __m256 g0 = _mm256_loadu_ps(j0);
+        __m256 g1 = _mm256_xor_ps(_mm256_loadu_ps(j1), conjSign);
+        __m256 a = permuteComplex256<_MM_SHUFFLE(3, 3, 0, 0)>(g0);
+        __m256 b = permuteComplex256<_MM_SHUFFLE(2, 2, 1, 1)>(g0);
+        __m256 c = permuteComplex256<_MM_SHUFFLE(3, 0, 3, 0)>(g1);
+        __m256 d = permuteComplex256<_MM_SHUFFLE(2, 1, 2, 1)>(g1);
+        __m256 m = _mm256_add_ps(cmul256(a, v), cmul256(b, _mm256_permute2f128_ps(v, v, 0x01)));
+        __m256 r = _mm256_add_ps(cmul256(m, c), cmul256(_mm256_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2)), d));
+        _mm256_storeu_ps(vis, r);
+        j0 += 8;
+        j1 += 8;
+        vis += 8;
+    }
+}
+
+__attribute__((target("avx2")))
+void jonesDiagAVX2(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    const __m256 conjSign = _mm256_setr_ps(0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f, 0.0f, -0.0f);
+    for (int f=0; f<nFreq; f++) {
+        __m256 a = permuteComplex256<_MM_SHUFFLE(3, 3, 0, 0)>(_mm256_loadu_ps(j0));
+        __m256 c = permuteComplex256<_MM_SHUFFLE(3, 0, 3, 0)>(_mm256_xor_ps(_mm256_loadu_ps(j1), conjSign));
+        _mm256_storeu_ps(vis, cmul256(cmul256(a, c), _mm256_loadu_ps(vis)));
+        j0 += 8;
+        j1 += 8;
+        vis += 8;
+    }
+}
+
+// Two channels per register, one in each 256 bit half. Adds use the
+// explicitly rounded form so they are not fused with the multiplies.
+__attribute__((target("avx512f")))
+static inline __m512 cmul512(__m512 a, __m512 b)
+{
+    const __m512i evenSign = _mm512_set1_epi64(0x80000000LL);
+    __m512 re = _mm512_mul_ps(_mm512_moveldup_ps(a), b);
+    __m512 im = _mm512_mul_ps(_mm512_movehdup_ps(a), _mm512_permute_ps(b, _MM_SHUFFLE(2, 3, 0, 1)));
+    im = _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(im), evenSign));
+    return _mm512_add_round_ps(re, im, _MM_FROUND_CUR_DIRECTION);
+}
+
+__attribute__((target("avx512f")))
+static inline __m512 conj512(__m512 x)
+{
+    const __m512i oddSign = _mm512_set1_epi64(static_cast<long long>(0x8000000000000000ULL));
+    return _mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(x), oddSign));
+}
+
+__attribute__((target("avx512f")))
+void jonesAVX512(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    int f = 0;
+    for (; f+2<=nFreq; f+=2) {
+        __m512 v = _mm512_loadu_ps(vis);
+        __m512d g0 = _mm512_castps_pd(_mm512_loadu_ps(j0));
+        __m512d g1 = _mm512_castps_pd(conj512(_mm512_loadu_ps(j1)));
+        __m512 a = _mm512_castpd_ps(_mm512_permutex_pd(g0, _MM_SHUFFLE(3, 3, 0, 0)));
+        __m512 b = _mm512_castpd_ps(_mm512_permutex_pd(g0, _MM_SHUFFLE(2, 2, 1, 1)));
+        __m512 c = _mm512_castpd_ps(_mm512_permutex_pd(g1, _MM_SHUFFLE(3, 0, 3, 0)));
+        __m512 d = _mm512_castpd_ps(_mm512_permutex_pd(g1, _MM_SHUFFLE(2, 1, 2, 1)));
+        __m512 vs = _mm512_shuffle_f32x4(v, v, _MM_SHUFFLE(2, 3, 0, 1));
+        __m512 m = _mm512_add_round_ps(cmul512(a, v), cmul512(b, vs), _MM_FROUND_CUR_DIRECTION);
+        __m512 ms = _mm512_permute_ps(m, _MM_SHUFFLE(1, 0, 3, 2));
+        _mm512_storeu_ps(vis, _mm512_add_round_ps(cmul512(m, c), cmul512(ms, d), _MM_FROUND_CUR_DIRECTION));
+        j0 += 16;
+        j1 += 16;
+        vis += 16;
+    }
+    if (f < nFreq)
+        jonesAVX2(j0, j1, nFreq - f, vis);
+}
+
+__attribute__((target("avx512f")))
+void jonesDiagAVX512(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    int f = 0;
+    for (; f+2<=nFreq; f+=2) {
+        __m512d g0 = _mm512_castps_pd(_mm512_loadu_ps(j0));
+        __m512d g1 = _mm512_castps_pd(conj512(_mm512_loadu_ps(j1)));
+        __m512 a = _mm512_castpd_ps(_mm512_permutex_pd(g0, _MM_SHUFFLE(3, 3, 0, 0)));
+        __m512 c = _mm512_castpd_ps(_mm512_permutex_pd(g1, _MM_SHUFFLE(3, 0, 3, 0)));
+        _mm512_storeu_ps(vis, cmul512(cmul512(a, c), _mm512_loadu_ps(vis)));
+        j0 += 16;
+        j1 += 16;
+        vis += 16;
+    }
+    if (f < nFreq)
+        jonesDiagAVX2(j0, j1, nFreq - f, vis);
+}
+
+#else
+
+void gatherRunSSE42(const float *re, const float *im, int freqStride,
+                    const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    gatherRunScalar(re, im, freqStride, sign, pattern, nFreq, out);
+}
+
+void gatherRunAVX2(const float *re, const float *im, int freqStride,
+                   const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    gatherRunScalar(re, im, freqStride, sign, pattern, nFreq, out);
+}
+
+void gatherRunAVX512(const float *re, const float *im, int freqStride,
+                     const float *sign, RunPattern pattern, int nFreq, float *out)
+{
+    gatherRunScalar(re, im, freqStride, sign, pattern, nFreq, out);
+}
+
+void complexMulSSE42(const float *factor, float *data, int n)
+{
+    complexMulScalar(factor, data, n);
+}
+
+void complexMulAVX2(const float *factor, float *data, int n)
+{
+    complexMulScalar(factor, data, n);
+}
+
+void complexMulAVX512(const float *factor, float *data, int n)
+{
+    complexMulScalar(factor, data, n);
+}
+
+void jonesAVX2(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    jonesScalar(j0, j1, nFreq, vis);
+}
+
+void jonesAVX512(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    jonesScalar(j0, j1, nFreq, vis);
+}
+
+void jonesDiagAVX2(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    jonesDiagScalar(j0, j1, nFreq, vis);
+}
+
+void jonesDiagAVX512(const float *j0, const float *j1, int nFreq, float *vis)
+{
+    jonesDiagScalar(j0, j1, nFreq, vis);
+}
+
+#endif // DADA_X86_KERNELS
+
+static const char *const simdNames[] = {"scalar", "sse4.2", "avx2", "avx512"};
+
+// Best instruction set supported by this CPU.
+static SimdLevel supportedSimdLevel()
+{
+#ifdef DADA_X86_KERNELS
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+        return SIMD_AVX512;
+    if (__builtin_cpu_supports("avx2"))
+        return SIMD_AVX2;
+    if (__builtin_cpu_supports("sse4.2"))
+        return SIMD_SSE42;
+#endif
+    return SIMD_SCALAR;
+}
+
+// The supported instruction set, or the one set by DADA2MS_SIMD if this CPU
+// has it. Asking for more than the CPU has would crash with an illegal
+// instruction, so that falls back to the best supported level with a
+// warning.
+static SimdLevel requestedSimdLevel()
+{
+    const SimdLevel supported = supportedSimdLevel();
+    const char *requested = getenv("DADA2MS_SIMD");
+    if (requested == NULL)
+        return supported;
+    const std::string name(requested);
+    for (int level=SIMD_SCALAR; level<=SIMD_AVX512; ++level) {
+        if (name != simdNames[level])
+            continue;
+        if (level <= supported)
+            return static_cast<SimdLevel>(level);
+        std::cerr << "Warning: this CPU does not support DADA2MS_SIMD=" << name << ", using "
+                  << simdNames[supported] << std::endl;
+        return supported;
+    }
+    throw std::invalid_argument("Unknown DADA2MS_SIMD value: " + name);
+}
+
+// Chosen once, so the warning is given once
+static SimdLevel selectSimdLevel()
+{
+    static const SimdLevel level = requestedSimdLevel();
+    return level;
+}
+
+const char *selectedSimdName()
+{
+    return simdNames[selectSimdLevel()];
+}
+
+GatherRunKernel selectGatherRunKernel()
+{
+    switch (selectSimdLevel()) {
+    case SIMD_AVX512:
+        return gatherRunAVX512;
+    case SIMD_AVX2:
+        return gatherRunAVX2;
+    case SIMD_SSE42:
+        return gatherRunSSE42;
+    default:
+        return gatherRunScalar;
+    }
+}
+
+ComplexMulKernel selectComplexMulKernel()
+{
+    switch (selectSimdLevel()) {
+    case SIMD_AVX512:
+        return complexMulAVX512;
+    case SIMD_AVX2:
+        return complexMulAVX2;
+    case SIMD_SSE42:
+        return complexMulSSE42;
+    default:
+        return complexMulScalar;
+    }
+}
+
+// There are no SSE versions of the Jones kernels: a channel does not fit in a
+// 128 bit register, so they would gain little over the scalar code.
+JonesKernel selectJonesKernel(bool diagonal)
+{
+    switch (selectSimdLevel()) {
+    case SIMD_AVX512:
+        return diagonal ? jonesDiagAVX512 : jonesAVX512;
+    case SIMD_AVX2:
+        return diagonal ? jonesDiagAVX2 : jonesAVX2;
+    default:
+        return diagonal ? jonesDiagScalar : jonesScalar;
+    }
+}
+
+} // namespace dada
@@ -0,0 +1,68 @@
+#ifndef REORDERKERNELS_H_
+#define REORDERKERNELS_H_
+
+namespace dada {
+
+// Layouts of the four correlations of one baseline within the raw xGPU data
+// that can be handled by the vectorised kernels. Any other layout (autos,
+// remapped lines) goes through the generic per-correlation gather.
+enum RunPattern {
+    RUN_NONE = 0,       // Not a run of four consecutive values
+    RUN_IDENTITY = 1,   // Output correlation c is at offset + c
+    RUN_TRANSPOSED = 2  // Output correlations XY and YX are swapped in the input
+};
+
+// Interleave the split real/imaginary xGPU planes for one baseline:
+//     out[f][c] = (re[f*freqStride + p(c)], sign[c] * im[f*freqStride + p(c)])
+// for f < nFreq and the four correlations c, where p is given by pattern.
+typedef void (*GatherRunKernel)(const float *re, const float *im, int freqStride,
+                                const float *sign, RunPattern pattern, int nFreq, float *out);
+
+// Kernel for the best instruction set supported by this CPU. The choice can
+// be lowered by setting DADA2MS_SIMD to scalar, sse4.2, avx2 or avx512.
+GatherRunKernel selectGatherRunKernel();
+// Name of the instruction set the selected kernels use
+const char *selectedSimdName();
+
+// Multiply interleaved complex values in place by a table of factors:
+//     data[k] *= factor[k]   for k < n
+// as (fr*dr - fi*di, fr*di + fi*dr) without fused multiply-adds, so every
+// version gives the same result.
+typedef void (*ComplexMulKernel)(const float *factor, float *data, int n);
+
+ComplexMulKernel selectComplexMulKernel();
+
+// Apply 2x2 Jones matrices to the visibilities of one baseline, in place:
+//     V[f] = J0[f] V[f] J1[f]^H   for f < nFreq
+// j0, j1 and vis hold 4 interleaved complex values (8 floats) per channel,
+// the matrices as [a b; c d] -> (a, b, c, d) and V as (XX, XY, YX, YY).
+// The diagonal kernels assume b = c = 0. All versions of a kernel give the
+// same result.
+typedef void (*JonesKernel)(const float *j0, const float *j1, int nFreq, float *vis);
+
+JonesKernel selectJonesKernel(bool diagonal);
+
+void gatherRunScalar(const float *re, const float *im, int freqStride,
+                     const float *sign, RunPattern pattern, int nFreq, float *out);
+void gatherRunSSE42(const float *re, const float *im, int freqStride,
+                    const float *sign, RunPattern pattern, int nFreq, float *out);
+void gatherRunAVX2(const float *re, const float *im, int freqStride,
+                   const float *sign, RunPattern pattern, int nFreq, float *out);
+void gatherRunAVX512(const float *re, const float *im, int freqStride,
+                     const float *sign, RunPattern pattern, int nFreq, float *out);
+
+void complexMulScalar(const float *factor, float *data, int n);
+void complexMulSSE42(const float *factor, float *data, int n);
+void complexMulAVX2(const float *factor, float *data, int n);
+void complexMulAVX512(const float *factor, float *data, int n);
+
+void jonesScalar(const float *j0, const float *j1, int nFreq, float *vis);
+void jonesAVX2(const float *j0, const float *j1, int nFreq, float *vis);
+void jonesAVX512(const float *j0, const float *j1, int nFreq, float *vis);
+void jonesDiagScalar(const float *j0, const float *j1, int nFreq, float *vis);
+void jonesDiagAVX2(const float *j0, const float *j1, int nFreq, float *vis);
+void jonesDiagAVX512(const float *j0, const float *j1, int nFreq, float *vis);
+
+} // namespace dada
+
+#endif // REORDERKERNELS_H_
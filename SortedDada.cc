@@ -4,40 +4,168 @@
 #include <iostream>
 #include <stdexcept>
 #include <vector>
+#include <algorithm>
 
 namespace dada {
 
+// Size and number of the reads kept in flight by READ_DIRECT
+static const size_t directRequestBytes = 8 << 20;
+static const int directRequestsInFlight = 8;
+
+// Unused gaps shorter than this are read through rather than skipped
+static const size_t readGapBytes = 64 << 10;
+
 SortedDada::SortedDada(const char *dadaFilename) :
     header(dadaFilename),
     mFileName(dadaFilename),
     mDadaFile(dadaFilename, std::ifstream::in | std::ifstream::binary),
+    mReadMode(READ_STREAM),
+    mMappedFile(NULL),
+    mDirectFile(NULL),
     mPrevChunk(-1),
     mOrder(header.nAnt(), header.nFreq(), header.nPol(), header.nCorr()),
     mInChunkBytes(mOrder.inputSize() * sizeof(float)),
     mRawData(mOrder.inputSize()),
     mSortedData(mOrder.outputSize()),
-    mOutVisFlags(outputSize(), static_cast<char>(false))
+    mGainData(NULL),
+    mGainFlagData(NULL),
+    mGainInterpolation(CAL_LINEAR)
+{
+}
+
+SortedDada::~SortedDada()
+{
+    delete mMappedFile;
+    delete mDirectFile;
+}
+
+void SortedDada::setReadMode(ReadMode mode)
+{
+    if (mode == READ_MMAP && mMappedFile == NULL)
+        mMappedFile = new MappedDadaFile(mFileName.c_str());
+    if (mode == READ_DIRECT && mDirectFile == NULL)
+        mDirectFile = new DirectDadaFile(mFileName.c_str(), directRequestBytes, directRequestsInFlight);
+    mReadMode = mode;
+}
+
+void SortedDada::selectChannels(int firstFreq, int nFreq)
+{
+    mOrder.selectChannels(firstFreq, nFreq);
+    resizeOutput();
+}
+
+void SortedDada::selectBaselines(const std::vector<int> &ant1, const std::vector<int> &ant2)
+{
+    mOrder.selectBaselines(ant1, ant2);
+    resizeOutput();
+}
+
+void SortedDada::selectAutos()
+{
+    mOrder.selectAutos();
+    resizeOutput();
+}
+
+// The selection sets the size of the sorted output
+void SortedDada::resizeOutput()
+{
+    mSortedData.resize(outputSize());
+}
+
+// Byte ranges of an integration, relative to its start, that the reorder
+// needs. Small gaps are merged so each range is worth a separate read.
+void SortedDada::readRanges(std::vector<DadaReorder::InputRange> &ranges)
+{
+    const std::vector<DadaReorder::InputRange> &used = mOrder.inputRanges();
+    ranges.clear();
+    for (size_t i=0; i<used.size(); ++i) {
+        DadaReorder::InputRange range = {used[i].offset * sizeof(float), used[i].length * sizeof(float)};
+        if (!ranges.empty() && range.offset - (ranges.back().offset + ranges.back().length) <= readGapBytes)
+            ranges.back().length = range.offset + range.length - ranges.back().offset;
+        else
+            ranges.push_back(range);
+    }
+}
+
+size_t SortedDada::chunkOffset(int index) const
 {
+    return header.headerSize() + static_cast<size_t>(index) * mInChunkBytes;
 }
 
 std::vector<float> &SortedDada::rRawChunk(int index)
+{
+    const float *raw = readRawChunk(index, mRawData);
+    if (raw != mRawData.data())
+        std::copy(raw, raw + mRawData.size(), mRawData.begin());
+    return mRawData;
+}
+
+// Read the raw data of an integration. With READ_MMAP the returned pointer is
+// into the file mapping and buffer is left alone, otherwise the data are read
+// into buffer. Only the parts used by the channel and baseline selection are
+// read (READ_DIRECT always streams whole integrations to keep its requests
+// sequential). One thread may read while another calls sortChunk().
+const float *SortedDada::readRawChunk(int index, std::vector<float> &buffer)
 {
     if (index < 0 || index >= header.nTime())
-        throw std::out_of_range("SortedDada::rRawChunk() Invalid index");
-    mDadaFile.seekg(header.headerSize() + index * mInChunkBytes, std::ios_base::beg);
-    if (!mDadaFile.good())
-        throw std::runtime_error("Seek Error in SortedDada::rRawChunk()");
-    mDadaFile.read(reinterpret_cast<char*>(mRawData.data()), mInChunkBytes);
-    if (!mDadaFile.good())
-        throw std::runtime_error("Read Error in SortedDada::rRawChunk()");
+        throw std::out_of_range("SortedDada::readRawChunk() Invalid index");
+    size_t offset = chunkOffset(index);
+    if (mReadMode == READ_MMAP) {
+        if (offset + mInChunkBytes > mMappedFile->size())
+            throw std::runtime_error("Read Error in SortedDada::readRawChunk() (file truncated)");
+        // Start reading this and the next integration before they are sorted
+        std::vector<DadaReorder::InputRange> ranges;
+        readRanges(ranges);
+        for (size_t i=0; i<ranges.size(); ++i) {
+            mMappedFile->willNeed(offset + ranges[i].offset, ranges[i].length);
+            mMappedFile->willNeed(offset + mInChunkBytes + ranges[i].offset, ranges[i].length);
+        }
+        mPrevChunk = index;
+        return reinterpret_cast<const float *>(mMappedFile->data() + offset);
+    }
+    buffer.resize(mOrder.inputSize());
+    char *dest = reinterpret_cast<char*>(buffer.data());
+    if (mReadMode == READ_DIRECT) {
+        mDirectFile->read(offset, mInChunkBytes, dest);
+        mPrevChunk = index;
+        return buffer.data();
+    }
+    std::vector<DadaReorder::InputRange> ranges;
+    readRanges(ranges);
+    for (size_t i=0; i<ranges.size(); ++i) {
+        mDadaFile.seekg(offset + ranges[i].offset, std::ios_base::beg);
+        if (!mDadaFile.good())
+            throw std::runtime_error("Seek Error in SortedDada::readRawChunk()");
+        mDadaFile.read(dest + ranges[i].offset, ranges[i].length);
+        if (!mDadaFile.good())
+            throw std::runtime_error("Read Error in SortedDada::readRawChunk()");
+    }
     mPrevChunk = index;
-    return mRawData;
+    return buffer.data();
+}
+
+// Reorder (and calibrate) raw data from readRawChunk(index). If visFlags is
+// given it receives the visibility flags for this integration (NULL when
+// nothing is flagged), which are shared rather than copied.
+void SortedDada::sortChunk(int index, const float *raw, std::vector<std::complex<float> > &sorted,
+                           std::shared_ptr<const FlagMask> *visFlags)
+{
+    sorted.resize(outputSize());
+    updateGains(index);
+    mOrder.sortData(raw, reinterpret_cast<float*>(sorted.data()));
+    if (visFlags != NULL)
+        *visFlags = mOrder.visFlags();
+    if (mReadMode == READ_MMAP) {
+        std::vector<DadaReorder::InputRange> ranges;
+        readRanges(ranges);
+        for (size_t i=0; i<ranges.size(); ++i)
+            mMappedFile->dontNeed(chunkOffset(index) + ranges[i].offset, ranges[i].length);
+    }
 }
 
 std::vector<std::complex<float> > &SortedDada::rGetChunk(int index)
 {
-    rRawChunk(index);
-    mOrder.sortData(mRawData.data(), reinterpret_cast<float*>(mSortedData.data()));
+    sortChunk(index, readRawChunk(index, mRawData), mSortedData, NULL);
     return mSortedData;
 }
 
@@ -48,48 +176,147 @@ std::vector<std::complex<float> > &SortedDada::rNextChunk()
 
 void SortedDada::applyGains(const std::vector<std::complex<float> > &gains, const std::vector<char> &gainFlags)
 {
-    int num_gains = header.nAnt() * header.nFreq() * header.nPol();
-    if (gains.size() != num_gains)
-        throw std::length_error("gains vector size error in SortedDada::applyGains");
-    if (gainFlags.size() != num_gains)
+    applyGains(std::vector<double>(1, 0.0), gains, gainFlags, CAL_NEAREST);
+}
+
+// Gains with a solution at each of times (MJD seconds, increasing), laid out
+// [solution][ant][freq][pol]. Each integration is calibrated with the
+// solution(s) for its mid-point, before the first or after the last solution
+// the nearest one. CAL_LINEAR interpolates the amplitude and phase of each
+// antenna's gain, as CASA does, so a phase drift between solutions does not
+// lower the amplitude.
+void SortedDada::applyGains(const std::vector<double> &times, const std::vector<std::complex<float> > &gains,
+                            const std::vector<char> &gainFlags, CalInterpolation interpolation)
+{
+    if (gainFlags.size() != gains.size())
         throw std::length_error("gainFlags vector size error in SortedDada::applyGains");
+    // The reorder caches products by pointer, so drop them before replacing
+    // the gains they point at
+    resetGains();
     mGains = gains;
     // Inputs are assumed to be CASA style gains, so invert them
-    for (int i=0; i<mGains.size(); ++i)
-        mGains[i] = std::complex<float>(1) / mGains[i];
+    invertGains(mGains);
     mGainFlags = gainFlags;
-    mOrder.applyGains(mGains.data(), mGainFlags.data(), mOutVisFlags.data());
+    applyInverseGains(times, mGains.data(), mGainFlags.data(), mGains.size(), interpolation);
+}
+
+// As applyGains() for gains that are already inverted, such as those of a
+// CalCache. They are used in place, so must stay valid until resetGains()
+// or the SortedDada is destroyed.
+void SortedDada::applyInverseGains(const std::vector<double> &times, const std::complex<float> *gains,
+                                   const char *gainFlags, size_t nGains, CalInterpolation interpolation)
+{
+    size_t num_gains = static_cast<size_t>(header.nAnt()) * header.nFreq() * header.nPol() * times.size();
+    if (times.empty())
+        throw std::length_error("no solution times in SortedDada::applyGains");
+    if (nGains != num_gains)
+        throw std::length_error("gains vector size error in SortedDada::applyGains");
+    for (size_t i=1; i<times.size(); ++i) {
+        if (times[i] <= times[i-1])
+            throw std::invalid_argument("solution times not increasing in SortedDada::applyGains");
+    }
+    mOrder.resetGains();
+    mGainData = gains;
+    mGainFlagData = gainFlags;
+    mGainTimes = times;
+    mGainInterpolation = interpolation;
+    mGainSolution[0] = mGainSolution[1] = -1;
+    if (times.size() == 1) {
+        mGainSolution[0] = 0;
+        mOrder.applyGains(mGainData, mGainFlagData);
+    }
+}
+
+void SortedDada::resetGains()
+{
+    mOrder.resetGains();
+    mGainTimes.clear();
+    mGainData = NULL;
+    mGainFlagData = NULL;
+}
+
+// Select the gain solution(s) for integration index. The reorder only
+// rebuilds its products when the solutions change.
+void SortedDada::updateGains(int index)
+{
+    if (mGainTimes.size() < 2)
+        return;
+    const double time = header.startTimeMJD() + (index + 0.5) * header.intTime();
+    const size_t next = std::upper_bound(mGainTimes.begin(), mGainTimes.end(), time) - mGainTimes.begin();
+    int solution0, solution1 = -1;
+    float weight = 0;
+    if (next == 0) {
+        solution0 = 0;
+    } else if (next == mGainTimes.size()) {
+        solution0 = next - 1;
+    } else if (mGainInterpolation == CAL_NEAREST) {
+        solution0 = (time - mGainTimes[next-1] <= mGainTimes[next] - time) ? next - 1 : next;
+    } else {
+        solution0 = next - 1;
+        solution1 = next;
+        weight = (time - mGainTimes[solution0]) / (mGainTimes[solution1] - mGainTimes[solution0]);
+    }
+    if (solution0 != mGainSolution[0] || solution1 != mGainSolution[1]) {
+        const size_t size = static_cast<size_t>(header.nAnt()) * header.nFreq() * header.nPol();
+        mOrder.applyGains(mGainData + solution0 * size, mGainFlagData + solution0 * size,
+                          solution1 < 0 ? NULL : mGainData + solution1 * size,
+                          solution1 < 0 ? NULL : mGainFlagData + solution1 * size);
+        mGainSolution[0] = solution0;
+        mGainSolution[1] = solution1;
+    }
+    mOrder.setGainWeight(weight);
 }
 
 void SortedDada::applyJones(const std::vector<std::complex<float> > &gains, const std::vector<char> &gainFlags)
 {
-    int num_gains = header.nAnt() * header.nFreq() * header.nPol() * header.nPol();
-    int num_flags = header.nAnt() * header.nFreq();
+    size_t num_gains = static_cast<size_t>(header.nAnt()) * header.nFreq() * header.nPol() * header.nPol();
+    size_t num_flags = static_cast<size_t>(header.nAnt()) * header.nFreq();
     if (gains.size() != num_gains)
         throw std::length_error("gains vector size error in SortedDada::applyPolarizedGains");
     if (gainFlags.size() != num_flags)
         throw std::length_error("gainFlags vector size error in SortedDada::applyPolarizedGains");
-    if (header.nPol() != 2)
-        throw std::logic_error("must have fully polarized visibilities to apply a Jones matrix calibration");
     mJones = gains;
     mJonesFlags = gainFlags;
-    // Invert each Jones matrix
-    // (note this is a numerically unstable operation, however we suppose that the Jones matrices
-    // are well-conditioned such that the numerical error introduced by this operation is
-    // insignificant relative to the thermal error in the measurement)
-    for (int i=0; i<header.nAnt()*header.nFreq(); ++i) {
-        if (mJonesFlags[i] == static_cast<char>(true)) continue;
-        std::complex<float> a = mJones[4*i+0];
-        std::complex<float> b = mJones[4*i+1];
-        std::complex<float> c = mJones[4*i+2];
-        std::complex<float> d = mJones[4*i+3];
+    invertJones(mJones, mJonesFlags);
+    applyInverseJones(mJones.data(), mJonesFlags.data(), mJonesFlags.size());
+}
+
+// As applyJones() for matrices that are already inverted, used in place
+void SortedDada::applyInverseJones(const std::complex<float> *gains, const char *gainFlags, size_t nFlags)
+{
+    if (nFlags != static_cast<size_t>(header.nAnt()) * header.nFreq())
+        throw std::length_error("gainFlags size error in SortedDada::applyInverseJones");
+    if (header.nPol() != 2)
+        throw std::logic_error("must have fully polarized visibilities to apply a Jones matrix calibration");
+    mOrder.applyJones(gains, gainFlags);
+}
+
+void SortedDada::invertGains(std::vector<std::complex<float> > &gains)
+{
+    for (size_t i=0; i<gains.size(); ++i)
+        gains[i] = std::complex<float>(1) / gains[i];
+}
+
+// Invert each unflagged Jones matrix
+// (note this is a numerically unstable operation, however we suppose that the Jones matrices
+// are well-conditioned such that the numerical error introduced by this operation is
+// insignificant relative to the thermal error in the measurement)
+void SortedDada::invertJones(std::vector<std::complex<float> > &jones, const std::vector<char> &flags)
+{
+    if (jones.size() != 4 * flags.size())
+        throw std::length_error("jones vector size error in SortedDada::invertJones");
+    for (size_t i=0; i<flags.size(); ++i) {
+        if (flags[i] == static_cast<char>(true)) continue;
+        std::complex<float> a = jones[4*i+0];
+        std::complex<float> b = jones[4*i+1];
+        std::complex<float> c = jones[4*i+2];
+        std::complex<float> d = jones[4*i+3];
         std::complex<float> inverse_determinant = std::complex<float>(1) / (a*d-b*c);
-        mJones[4*i+0] = +d*inverse_determinant;
-        mJones[4*i+1] = -b*inverse_determinant;
-        mJones[4*i+2] = -c*inverse_determinant;
-        mJones[4*i+3] = +a*inverse_determinant;
+        jones[4*i+0] = +d*inverse_determinant;
+        jones[4*i+1] = -b*inverse_determinant;
+        jones[4*i+2] = -c*inverse_determinant;
+        jones[4*i+3] = +a*inverse_determinant;
     }
-    mOrder.applyJones(mJones.data(), mJonesFlags.data(), mOutVisFlags.data());
 }
 
 } // namespace dada
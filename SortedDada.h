@@ -3,9 +3,12 @@
 
 #include "DadaHeader.h"
 #include "DadaReorder.h"
+#include "MappedDadaFile.h"
+#include "DirectDadaFile.h"
 #include <complex>
 #include <string>
 #include <fstream>
+#include <memory>
 #include <vector>
 
 namespace dada {
@@ -13,37 +16,79 @@ namespace dada {
 class SortedDada
 {
 public:
+    enum ReadMode {
+        READ_STREAM, // seek + read each integration into a buffer
+        READ_MMAP,   // gather directly from a memory map of the file
+        READ_DIRECT  // large O_DIRECT reads kept in flight, bypassing the page cache
+    };
+    // How gains with several solutions are applied between solution times
+    enum CalInterpolation {
+        CAL_NEAREST, // solution nearest in time
+        CAL_LINEAR   // linear in amplitude and phase between the solutions either side
+    };
     SortedDada(const char *dadaFilename);
+    ~SortedDada();
     const DadaHeader header;
     int inputSize() const {return mOrder.inputSize();};
     int outputSize() const {return mOrder.outputSize();};
+    void selectChannels(int firstFreq, int nFreq);
+    void selectBaselines(const std::vector<int> &ant1, const std::vector<int> &ant2);
+    void selectAutos();
+    int firstFreq() const {return mOrder.firstFreq();};
+    int nOutFreq() const {return mOrder.nOutFreq();};
+    int nOutBaseline() const {return mOrder.nOutBaseline();};
+    const std::vector<int> &outAnt1() const {return mOrder.outAnt1();};
+    const std::vector<int> &outAnt2() const {return mOrder.outAnt2();};
     void setLineMapping(int corrInput, int cable) {return mOrder.setLineMapping(corrInput, cable);};
     void setLineMapping(const char *corrInput, const char *cable) {return mOrder.setLineMapping(corrInput, cable);};
     int setLineMappingFromFile(const char *filename) {return mOrder.setLineMappingFromFile(filename);};
+    void setNumThreads(int nThreads) {mOrder.setNumThreads(nThreads);};
     void applyGains(const std::vector<std::complex<float> > &gains, const std::vector<char> &gainFlags);
+    void applyGains(const std::vector<double> &times, const std::vector<std::complex<float> > &gains,
+                    const std::vector<char> &gainFlags, CalInterpolation interpolation);
+    void applyInverseGains(const std::vector<double> &times, const std::complex<float> *gains,
+                           const char *gainFlags, size_t nGains, CalInterpolation interpolation);
     void applyJones(const std::vector<std::complex<float> > &gains, const std::vector<char> &gainFlags);
-    void resetGains() {mOrder.resetGains();};
+    void applyInverseJones(const std::complex<float> *gains, const char *gainFlags, size_t nFlags);
+    void resetGains();
+    static void invertGains(std::vector<std::complex<float> > &gains);
+    static void invertJones(std::vector<std::complex<float> > &jones, const std::vector<char> &flags);
+    void setReadMode(ReadMode mode);
     std::vector<float> &rRawChunk(int index);
+    const float *readRawChunk(int index, std::vector<float> &buffer);
+    void sortChunk(int index, const float *raw, std::vector<std::complex<float> > &sorted,
+                   std::shared_ptr<const FlagMask> *visFlags);
     std::vector<std::complex<float> > &rGetChunk(int index);
     std::vector<std::complex<float> > &rNextChunk();
-    std::vector<char> &rCurrentVisFlags() {return mOutVisFlags;};
+    std::shared_ptr<const FlagMask> currentVisFlags() const {return mOrder.visFlags();};
     int prevChunkIndex() const {return mPrevChunk;};
     const char *filename() const {return mFileName.c_str();};
     void rewind() {mPrevChunk=-1;};
 private:
     std::string mFileName;
     std::ifstream mDadaFile;
+    ReadMode mReadMode;
+    MappedDadaFile *mMappedFile;
+    DirectDadaFile *mDirectFile;
     int mPrevChunk;
     DadaReorder mOrder;
     int mInChunkBytes;
     std::vector<float> mRawData;
     std::vector<std::complex<float> > mSortedData;
-    std::vector<std::complex<float> > mGains;
+    std::vector<std::complex<float> > mGains;  // [solution][ant][freq][pol]
+    const std::complex<float> *mGainData;       // Inverse gains applied: mGains or a CalCache
+    const char *mGainFlagData;
+    std::vector<double> mGainTimes;             // MJD seconds of each solution
+    CalInterpolation mGainInterpolation;
+    int mGainSolution[2];                       // Solutions currently applied, -1 if none
     std::vector<std::complex<float> > mJones;
     // std::vector<bool> is bit packed so we'll use chars
     std::vector<char> mGainFlags;
     std::vector<char> mJonesFlags;
-    std::vector<char> mOutVisFlags;
+    size_t chunkOffset(int index) const;
+    void resizeOutput();
+    void readRanges(std::vector<DadaReorder::InputRange> &ranges);
+    void updateGains(int index);
 };
 
 } // namespace dada
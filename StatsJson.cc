@@ -0,0 +1,35 @@
+#include "StatsJson.h"
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+namespace dada {
+
+std::string jsonString(const std::string &s)
+{
+    std::ostringstream out;
+    out << '"';
+    for (size_t i=0; i<s.size(); ++i) {
+        const unsigned char c = s[i];
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (c < 0x20)
+            out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec;
+        else
+            out << c;
+    }
+    out << '"';
+    return out.str();
+}
+
+std::string jsonRate(double amount, double seconds)
+{
+    const double rate = amount / seconds;
+    if (!(seconds > 0) || !std::isfinite(rate))
+        return "null";
+    std::ostringstream out;
+    out << rate;
+    return out.str();
+}
+
+} // namespace dada
@@ -0,0 +1,17 @@
+#ifndef STATSJSON_H_
+#define STATSJSON_H_
+
+#include <string>
+
+namespace dada {
+
+// Values for the --stats-json output.
+// s as a JSON string, quoted and escaped
+std::string jsonString(const std::string &s);
+// amount / seconds, or null where there is none to report (no time was
+// spent), as JSON has no inf or nan
+std::string jsonRate(double amount, double seconds);
+
+} // namespace dada
+
+#endif // STATSJSON_H_
@@ -0,0 +1,80 @@
+#include "ThreadPool.h"
+#include <stdexcept>
+
+namespace dada {
+
+ThreadPool::ThreadPool(int nThreads) :
+    mTask(NULL), mNTasks(0), mNextTask(0), mBusy(0), mGeneration(0), mStop(false)
+{
+    if (nThreads < 1)
+        throw std::invalid_argument("ThreadPool needs at least one thread");
+    // The thread calling run() does its share of the work
+    for (int i=1; i<nThreads; ++i)
+        mWorkers.push_back(std::thread(&ThreadPool::workerLoop, this));
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStop = true;
+    }
+    mWake.notify_all();
+    for (size_t i=0; i<mWorkers.size(); ++i)
+        mWorkers[i].join();
+}
+
+void ThreadPool::run(int nTasks, const std::function<void(int)> &task)
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mTask = &task;
+    mNTasks = nTasks;
+    mNextTask = 0;
+    mError = std::exception_ptr();
+    ++mGeneration;
+    mWake.notify_all();
+    runTasks(lock);
+    mDone.wait(lock, [this] {return mBusy == 0 && mNextTask >= mNTasks;});
+    mTask = NULL;
+    if (mError)
+        std::rethrow_exception(mError);
+}
+
+void ThreadPool::workerLoop()
+{
+    unsigned long seen = 0;
+    std::unique_lock<std::mutex> lock(mMutex);
+    while (true) {
+        mWake.wait(lock, [&] {return mStop || mGeneration != seen;});
+        if (mStop)
+            return;
+        seen = mGeneration;
+        runTasks(lock);
+    }
+}
+
+// Claim and run tasks until none are left. Called with the lock held.
+void ThreadPool::runTasks(std::unique_lock<std::mutex> &lock)
+{
+    while (mTask != NULL && mNextTask < mNTasks) {
+        int index = mNextTask++;
+        const std::function<void(int)> &task = *mTask;
+        ++mBusy;
+        lock.unlock();
+        try {
+            task(index);
+        } catch (...) {
+            lock.lock();
+            if (!mError)
+                mError = std::current_exception();
+            mNextTask = mNTasks;
+            lock.unlock();
+        }
+        lock.lock();
+        --mBusy;
+    }
+    if (mBusy == 0)
+        mDone.notify_all();
+}
+
+} // namespace dada
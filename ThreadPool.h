@@ -0,0 +1,39 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace dada {
+
+// A fixed set of worker threads for data-parallel loops. run() hands out
+// task indices to the workers and the calling thread, and returns once all
+// of them have finished. The first exception thrown by a task is rethrown
+// from run().
+class ThreadPool
+{
+public:
+    ThreadPool(int nThreads);
+    ~ThreadPool();
+    int size() const {return mWorkers.size() + 1;};
+    void run(int nTasks, const std::function<void(int)> &task);
+private:
+    std::vector<std::thread> mWorkers;
+    std::mutex mMutex;
+    std::condition_variable mWake, mDone;
+    const std::function<void(int)> *mTask;
+    int mNTasks, mNextTask, mBusy;
+    unsigned long mGeneration;
+    bool mStop;
+    std::exception_ptr mError;
+    void workerLoop();
+    void runTasks(std::unique_lock<std::mutex> &lock);
+};
+
+} // namespace dada
+
+#endif // THREADPOOL_H_
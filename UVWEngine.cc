@@ -0,0 +1,56 @@
+/*
+ * UVWEngine.cc
+ */
+
+#include "UVWEngine.h"
+#include <measures/Measures/Muvw.h>
+#include <measures/Measures/MEpoch.h>
+
+using namespace casa;
+
+namespace dada2ms {
+
+UVWEngine::UVWEngine(const Matrix<Double> &itrf, const Vector<Int> &ant1, const Vector<Int> &ant2,
+                     const MPosition &arrayPos) :
+    mFrame(MEpoch(Quantity(0.0, "s"), MEpoch::UTC), arrayPos, MDirection(MVDirection(0.0, 0.0, 1.0), MDirection::J2000)),
+    mToJ2000(MBaseline::Ref(MBaseline::ITRF, mFrame), MBaseline::Ref(MBaseline::J2000)),
+    mX(ant1.nelements()),
+    mY(ant1.nelements()),
+    mZ(ant1.nelements())
+{
+    for (uInt bl=0; bl<ant1.nelements(); ++bl) {
+        mX[bl] = itrf(0, ant1[bl]) - itrf(0, ant2[bl]);
+        mY[bl] = itrf(1, ant1[bl]) - itrf(1, ant2[bl]);
+        mZ[bl] = itrf(2, ant1[bl]) - itrf(2, ant2[bl]);
+    }
+}
+
+void UVWEngine::compute(double time, const MDirection &phaseCentre, Matrix<Double> &uvw)
+{
+    const MVDirection dir = phaseCentre.getValue();
+    mFrame.resetEpoch(MVEpoch(Quantity(time, "s")));
+    mFrame.resetDirection(dir);
+    // The rotation and projection are linear, so their combination is the
+    // matrix whose columns are the UVWs of the ITRF unit vectors
+    double m[3][3];
+    for (int axis=0; axis<3; ++axis) {
+        const MVBaseline unit(axis == 0 ? 1.0 : 0.0, axis == 1 ? 1.0 : 0.0, axis == 2 ? 1.0 : 0.0);
+        const Vector<Double> column = MVuvw(mToJ2000(unit).getValue(), dir).getValue();
+        for (int k=0; k<3; ++k)
+            m[k][axis] = column[k];
+    }
+
+    const size_t nBaseline = mX.size();
+    uvw.resize(3, nBaseline);
+    Bool deleteIt;
+    Double *out = uvw.getStorage(deleteIt);
+    const double *x = mX.data(), *y = mY.data(), *z = mZ.data();
+    for (size_t bl=0; bl<nBaseline; ++bl) {
+        out[3 * bl + 0] = m[0][0] * x[bl] + m[0][1] * y[bl] + m[0][2] * z[bl];
+        out[3 * bl + 1] = m[1][0] * x[bl] + m[1][1] * y[bl] + m[1][2] * z[bl];
+        out[3 * bl + 2] = m[2][0] * x[bl] + m[2][1] * y[bl] + m[2][2] * z[bl];
+    }
+    uvw.putStorage(out, deleteIt);
+}
+
+} // namespace dada2ms
@@ -0,0 +1,47 @@
+/*
+ * UVWEngine.h
+ */
+
+#ifndef UVWENGINE_H_
+#define UVWENGINE_H_
+
+#include <vector>
+
+// casacore headers
+#include <casa/Arrays.h>
+#include <measures/Measures/MBaseline.h>
+#include <measures/Measures/MCBaseline.h>
+#include <measures/Measures/MDirection.h>
+#include <measures/Measures/MPosition.h>
+#include <measures/Measures/MeasFrame.h>
+
+namespace dada2ms {
+
+// J2000 UVWs of a set of baselines, as MSUVWGenerator computes them but for
+// all baselines of an integration at once. Like zenithUVWs, a baseline's UVW
+// is that of ant1 less that of ant2, matching the conjugation of the
+// visibilities. The ITRF to J2000 rotation and the projection towards the phase
+// centre are combined into one 3x3 matrix per integration, from one frame
+// and conversion engine kept for the whole run, and applied to the ITRF
+// baseline vectors.
+class UVWEngine
+{
+public:
+    // itrf is [antenna][xyz] ITRF positions (m), the baselines are
+    // ant1-ant2 and arrayPos is the position of the array
+    UVWEngine(const casa::Matrix<casa::Double> &itrf, const casa::Vector<casa::Int> &ant1,
+              const casa::Vector<casa::Int> &ant2, const casa::MPosition &arrayPos);
+    // UVWs, [baseline][3], at time (MJD seconds, UTC) towards the J2000
+    // direction phaseCentre
+    void compute(double time, const casa::MDirection &phaseCentre, casa::Matrix<casa::Double> &uvw);
+private:
+    casa::MeasFrame mFrame;
+    casa::MBaseline::Convert mToJ2000;
+    std::vector<double> mX, mY, mZ; // ITRF baseline vectors
+    UVWEngine(const UVWEngine &);
+    UVWEngine &operator=(const UVWEngine &);
+};
+
+} // namespace dada2ms
+
+#endif /* UVWENGINE_H_ */
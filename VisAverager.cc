@@ -0,0 +1,84 @@
+#include "VisAverager.h"
+#include <algorithm>
+#include <stdexcept>
+
+namespace dada {
+
+VisAverager::VisAverager(int nBaseline, int nFreq, int nCorr, int freqAvg) :
+    mNBaseline(nBaseline), mNFreq(nFreq), mNCorr(nCorr), mFreqAvg(freqAvg),
+    mNOutFreq(freqAvg > 0 ? (nFreq + freqAvg - 1) / freqAvg : 0), mNAdded(0)
+{
+    if (freqAvg < 1)
+        throw std::invalid_argument("VisAverager: frequency averaging must be at least 1");
+}
+
+void VisAverager::reset()
+{
+    const size_t size = static_cast<size_t>(mNBaseline) * mNOutFreq * mNCorr;
+    mSum.assign(size, std::complex<float>(0));
+    mWeight.assign(size, 0);
+    mNAdded = 0;
+}
+
+// Accumulate one integration. flags may be NULL if nothing is flagged.
+void VisAverager::add(const std::complex<float> *data, const FlagMask *flags)
+{
+    if (mSum.empty())
+        reset();
+    if (mFreqAvg == 1) {
+        const size_t size = mSum.size();
+        for (size_t i=0; i<size; ++i) {
+            if (flags == NULL || !(*flags)[i]) {
+                mSum[i] += data[i];
+                mWeight[i] += 1;
+            }
+        }
+    } else {
+        size_t in = 0;
+        for (int bl=0; bl<mNBaseline; ++bl) {
+            for (int f=0; f<mNFreq; ++f) {
+                size_t out = (static_cast<size_t>(bl) * mNOutFreq + f / mFreqAvg) * mNCorr;
+                for (int corr=0; corr<mNCorr; ++corr, ++in) {
+                    if (flags == NULL || !(*flags)[in]) {
+                        mSum[out + corr] += data[in];
+                        mWeight[out + corr] += 1;
+                    }
+                }
+            }
+        }
+    }
+    ++mNAdded;
+}
+
+// Turn the sums into averages.
+void VisAverager::finish()
+{
+    const size_t size = mSum.size();
+    for (size_t i=0; i<size; ++i) {
+        if (mWeight[i] > 0)
+            mSum[i] /= mWeight[i];
+    }
+}
+
+void VisAverager::flags(bool *flags) const
+{
+    const size_t size = mWeight.size();
+    for (size_t i=0; i<size; ++i)
+        flags[i] = mWeight[i] == 0;
+}
+
+// Per-row weights, [baseline][corr]: the mean over output channels of the
+// weight spectrum, so a single unflagged sample has weight 1.
+void VisAverager::rowWeights(float *weight) const
+{
+    for (int bl=0; bl<mNBaseline; ++bl) {
+        for (int corr=0; corr<mNCorr; ++corr) {
+            float sum = 0;
+            for (int f=0; f<mNOutFreq; ++f)
+                sum += mWeight[(static_cast<size_t>(bl) * mNOutFreq + f) * mNCorr + corr];
+            weight[bl * mNCorr + corr] = sum / mNOutFreq;
+        }
+    }
+}
+
+} // namespace dada
@@ -0,0 +1,39 @@
+#ifndef VISAVERAGER_H_
+#define VISAVERAGER_H_
+
+#include <complex>
+#include <vector>
+#include "FlagMask.h"
+
+namespace dada {
+
+// Flag-aware average of several sorted integrations, [baseline][freq][corr],
+// optionally also over groups of freqAvg adjacent channels. Flagged samples
+// are left out of the average. Outputs with no unflagged samples come out as
+// zero and flagged. The outputs have nOutFreq() channels; when freqAvg does
+// not divide nFreq the last averages the remaining nFreq % freqAvg channels.
+class VisAverager
+{
+public:
+    VisAverager(int nBaseline, int nFreq, int nCorr, int freqAvg);
+    int nOutFreq() const {return mNOutFreq;};
+    void reset();
+    void add(const std::complex<float> *data, const FlagMask *flags);
+    void finish();
+    int nAdded() const {return mNAdded;};
+    std::vector<std::complex<float> > &rData() {return mSum;};
+    // Outputs with no unflagged samples, one bool each (eg a Cube<Bool>)
+    void flags(bool *flags) const;
+    // Number of unflagged samples in each average, [baseline][outFreq][corr]
+    std::vector<float> &rWeightSpectrum() {return mWeight;};
+    void rowWeights(float *weight) const;
+private:
+    const int mNBaseline, mNFreq, mNCorr, mFreqAvg, mNOutFreq;
+    int mNAdded;
+    std::vector<std::complex<float> > mSum;
+    std::vector<float> mWeight;
+};
+
+} // namespace dada
+
+#endif // VISAVERAGER_H_
@@ -0,0 +1,132 @@
+//
+// Write a synthetic LEDA dada file, and a matching antenna file, for
+// benchmarking dada2ms without real captures.
+//
+// The header has the keys DadaHeader reads and the payload is xGPU ordered,
+// [time][real/imag][freq][gpuBaseline][pol], with noise-like values.
+//
+// g++ -O2 -o makedada makedada.cc -lboost_program_options
+//
+
+#include <boost/program_options.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+static const int headerSize = 4096;
+
+// xorshift64*, so the data are the same on every run
+static uint64_t nextRandom(uint64_t &state)
+{
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * 2685821657736338717ULL;
+}
+
+static float uniform(uint64_t &state)
+{
+    return (nextRandom(state) >> 40) / static_cast<float>(1 << 24) - 0.5f;
+}
+
+int main(int argc, char *argv[])
+{
+    namespace po = boost::program_options;
+    int nAnt, nFreq, nPol, nTime;
+    double intTime, tSamp, cFreq, chanBW;
+    std::string dadaName, antName;
+    po::options_description poOptions("Options");
+    poOptions.add_options()
+        ("help,h", "produce this help message")
+        ("ants", po::value<int>(&nAnt)->default_value(256), "number of antennas (NSTATION), even")
+        ("chans", po::value<int>(&nFreq)->default_value(109), "number of channels (NCHAN)")
+        ("pols", po::value<int>(&nPol)->default_value(2), "number of polarisations (NPOL)")
+        ("ints", po::value<int>(&nTime)->default_value(10), "number of integrations")
+        ("int-time", po::value<double>(&intTime)->default_value(9.0), "integration time (s)")
+        ("tsamp", po::value<double>(&tSamp)->default_value(40.0), "sample time (us, TSAMP)")
+        ("cfreq", po::value<double>(&cFreq)->default_value(58.3), "centre frequency (MHz)")
+        ("chan-bw", po::value<double>(&chanBW)->default_value(0.024), "channel bandwidth (MHz)")
+        ("antfile", po::value<std::string>(&antName), "also write antenna offsets (m) to this file")
+        ("output,o", po::value<std::string>(&dadaName)->required(), "dada file to write")
+    ;
+    po::positional_options_description poPos;
+    poPos.add("output", 1);
+    po::variables_map args;
+    po::store(po::command_line_parser(argc, argv).options(poOptions).positional(poPos).run(), args);
+    if (args.count("help")) {
+        std::cout << "Write a synthetic LEDA dada file." << std::endl << std::endl;
+        std::cout << "Usage: " << argv[0] << " [options] <dada>" << std::endl;
+        std::cout << poOptions << std::endl;
+        exit(EXIT_SUCCESS);
+    }
+    po::notify(args);
+    if (nAnt < 2 || nAnt % 2 != 0 || nFreq < 1 || nPol < 1 || nTime < 1 || intTime <= 0 || tSamp <= 0) {
+        std::cerr << "Error: need an even number of antennas and positive sizes and times" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // As DadaReorder: the xGPU triangle is stored in 2x2 antenna blocks
+    const long gpuBaselines = static_cast<long>(nAnt) * (nAnt / 2 + 1);
+    const long nCorr = nPol * nPol;
+    const long floatsPerAvg = 2 * nFreq * gpuBaselines * nCorr;
+    const long bytesPerAvg = floatsPerAvg * sizeof(float);
+    const long navg = std::max(1L, static_cast<long>(std::floor(intTime * 1e6 / tSamp + 0.5)));
+
+    std::ostringstream header;
+    header << "HDR_SIZE " << headerSize << "\n"
+           << "NSTATION " << nAnt << "\n"
+           << "NCHAN " << nFreq << "\n"
+           << "NPOL " << nPol << "\n"
+           << "NAVG " << navg << "\n"
+           << "TSAMP " << tSamp << "\n"
+           << "CFREQ " << cFreq << "\n"
+           << "BW " << nFreq * chanBW << "\n"
+           << "FILE_SIZE " << bytesPerAvg * nTime << "\n"
+           << "BYTES_PER_AVG " << bytesPerAvg << "\n"
+           << "OBS_OFFSET 0\n"
+           << "UTC_START 2014-05-01-12:00:00\n";
+    std::string headerText = header.str();
+    if (headerText.size() > static_cast<size_t>(headerSize)) {
+        std::cerr << "Error: header too long" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    headerText.resize(headerSize, ' ');
+
+    std::ofstream out(dadaName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc);
+    out.write(headerText.data(), headerText.size());
+    // One block of noise, varied a little per integration so that
+    // integrations differ without generating each from scratch
+    uint64_t state = 0x9E3779B97F4A7C15ULL;
+    std::vector<float> payload(floatsPerAvg);
+    for (long i=0; i<floatsPerAvg; ++i)
+        payload[i] = uniform(state);
+    for (int t=0; t<nTime; ++t) {
+        for (long i=t % 97; i<floatsPerAvg; i+=97)
+            payload[i] += uniform(state);
+        out.write(reinterpret_cast<const char *>(payload.data()), bytesPerAvg);
+    }
+    out.close();
+    if (!out) {
+        std::cerr << "Error writing " << dadaName << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (!antName.empty()) {
+        // Antennas scattered over a 200 m square
+        std::ofstream ants(antName.c_str());
+        for (int a=0; a<nAnt; ++a)
+            ants << 200 * uniform(state) << " " << 200 * uniform(state) << " " << uniform(state) << "\n";
+        if (!ants) {
+            std::cerr << "Error writing " << antName << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    return 0;
+}
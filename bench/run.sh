@@ -0,0 +1,85 @@
+#!/bin/bash
+#
+# End-to-end throughput benchmark: convert synthetic dada files with dada2ms
+# and append one JSON line per run (dada2ms --stats-json, plus the build and
+# date) to a results file, so that throughput can be compared across builds.
+#
+# Usage: bench/run.sh [dada2ms binary]
+#
+# Each of these is a space separated list, and every combination is run:
+#   ANTS (256), CHANS (109), INTS (10), THREADS (1 4), QUEUE (4), BATCH (1),
+#   READER (stream)
+# Other settings:
+#   EXTRA    more dada2ms options for every run
+#   WORKDIR  where the dada files and MSs go (/tmp/dada2ms-bench)
+#   RESULTS  results file (bench/results.jsonl)
+#   KEEP     set to keep the MSs
+#
+
+set -e
+
+BENCH=$(cd "$(dirname "$0")" && pwd)
+DADA2MS=${1:-$BENCH/../dada2ms}
+ANTS=${ANTS:-256}
+CHANS=${CHANS:-109}
+INTS=${INTS:-10}
+THREADS=${THREADS:-1 4}
+QUEUE=${QUEUE:-4}
+BATCH=${BATCH:-1}
+READER=${READER:-stream}
+WORKDIR=${WORKDIR:-/tmp/dada2ms-bench}
+RESULTS=${RESULTS:-$BENCH/results.jsonl}
+
+if [ ! -x "$DADA2MS" ]; then
+    echo "Error: no dada2ms binary at $DADA2MS" >&2
+    exit 1
+fi
+mkdir -p "$WORKDIR"
+MAKEDADA=$WORKDIR/makedada
+if [ ! -x "$MAKEDADA" ] || [ "$BENCH/makedada.cc" -nt "$MAKEDADA" ]; then
+    g++ -O2 -o "$MAKEDADA" "$BENCH/makedada.cc" -lboost_program_options
+fi
+BUILD=$(git -C "$BENCH" describe --always --dirty 2>/dev/null || echo unknown)
+
+# $1 escaped for use inside a JSON string
+json_escape() {
+    printf '%s' "$1" | sed 's/\\/\\\\/g; s/"/\\"/g; s/\t/\\t/g'
+}
+
+for ants in $ANTS; do
+for chans in $CHANS; do
+for ints in $INTS; do
+    # Generated once for each size, then reused by every run of that size
+    dada=$WORKDIR/synth-${ants}a-${chans}c-${ints}i.dada
+    antfile=$WORKDIR/antpos-${ants}.txt
+    if [ ! -f "$dada" ] || [ ! -f "$antfile" ]; then
+        "$MAKEDADA" --ants "$ants" --chans "$chans" --ints "$ints" --antfile "$antfile" "$dada"
+    fi
+    cfg=$WORKDIR/bench-${ants}.cfg
+    cat > "$cfg" <<EOF
+longitude = -118.281667
+latitude = 37.23978
+altitude = 1184.120
+antfile = $antfile
+EOF
+    for threads in $THREADS; do
+    for queue in $QUEUE; do
+    for batch in $BATCH; do
+    for reader in $READER; do
+        ms=$WORKDIR/bench.ms
+        stats=$WORKDIR/stats.json
+        rm -rf "$ms" "$stats"
+        echo "ants $ants chans $chans ints $ints threads $threads queue $queue batch $batch reader $reader" >&2
+        "$DADA2MS" -c "$cfg" --threads "$threads" --queue-depth "$queue" --batch "$batch" \
+            --reader "$reader" --stats-json "$stats" $EXTRA "$dada" "$ms" > /dev/null
+        echo "{\"build\": \"$(json_escape "$BUILD")\", \"date\": \"$(date -u +%Y-%m-%dT%H:%M:%SZ)\", \"host\": \"$(json_escape "$(hostname)")\", \"extra\": \"$(json_escape "$EXTRA")\", \"run\": $(cat "$stats")}" >> "$RESULTS"
+        [ -n "$KEEP" ] || rm -rf "$ms"
+    done
+    done
+    done
+    done
+done
+done
+done
+
+echo "Results appended to $RESULTS" >&2
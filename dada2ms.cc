@@ -15,17 +15,21 @@
 //
 // g++ -O3 -I$CASACORE_INC_DIR -L$CASACORE_LIB_DIR -o dada2ms *.cc
 //     -lcasa_casa -lcasa_measures -lcasa_ms -lcasa_tables -lcasa_scimath -lcasa_scimath_f
-//     -lboost_program_options
+//     -lboost_program_options -pthread
 //
 // Stephen Bourke, Caltech
 // March, 2014.
 //
 
 #include <sstream>
+#include <fstream>
 #include <iomanip>
+#include <chrono>
 #include <stdexcept>
 #include <vector>
 #include <complex>
+#include <algorithm>
+#include <cmath>
 
 // casacore headers
 #include <casa/Arrays.h>
@@ -34,18 +38,78 @@
 
 #include "options.h"
 #include "SortedDada.h"
+#include "ChunkPipeline.h"
+#include "StatsJson.h"
+#include "ReorderKernels.h"
+#include "VisAverager.h"
 #include "ms_funcs.h"
+#include "IntegrationWriter.h"
+#include "UVWEngine.h"
 #include "MSUVWGenerator.h"
 
 #include "BCalTable.h"
 #include "JCalTable.h"
+#include "CalCache.h"
 
 using namespace casa;
 
+// Inverted gains (or Jones matrices) of a calibration table from the cache in
+// cacheDir, compiling the table into the cache first if its entry is missing
+// or out of date. kind is 'G' for a CASA table, or the TTCal table type.
+static dada::CalCache *
+compiledCal(const std::string &cacheDir, const std::string &table, char kind)
+{
+	dada::CalCache *cache = new dada::CalCache(cacheDir, table, kind);
+	if (!cache->isCurrent()) {
+		std::vector<double> times(1, 0.0);
+		std::vector<std::complex<float> > gains;
+		std::vector<char> flags;
+		if (kind == 'G') {
+			readCalTable(table.c_str(), times, gains, flags);
+			dada::SortedDada::invertGains(gains);
+		} else if (kind == 'B') {
+			BCalTable bcal(table.c_str());
+			gains = bcal.gains();
+			flags = bcal.flags();
+			dada::SortedDada::invertGains(gains);
+		} else {
+			JCalTable jcal(table.c_str());
+			gains = jcal.gains();
+			flags = jcal.flags();
+			dada::SortedDada::invertJones(gains, flags);
+		}
+		cache->update(times, gains, flags);
+	}
+	return cache;
+}
+
+// Layout of a visibility column of elementBits per value: a preset,
+// adjusted by any explicit settings (which start from the write preset
+// otherwise)
+static ColumnLayout
+visLayout(const dada2ms::options &opts, int nCorr, int nFreq, int nBaseline, int elementBits)
+{
+	ColumnLayout layout = columnLayout(opts.layout, nCorr, nFreq, nBaseline, elementBits);
+	if (!opts.dataStMan.empty() || !opts.tileShape.empty() || opts.bucketSize > 0 || opts.tileCacheMB >= 0) {
+		if (opts.layout == "default")
+			layout = columnLayout("write", nCorr, nFreq, nBaseline, elementBits);
+		if (!opts.dataStMan.empty())
+			layout.stMan = opts.dataStMan;
+		if (!opts.tileShape.empty())
+			layout.tileShape = IPosition(3, opts.tileShape[0], opts.tileShape[1], opts.tileShape[2]);
+		if (opts.bucketSize > 0)
+			layout.bucketSize = opts.bucketSize;
+		if (opts.tileCacheMB >= 0)
+			layout.cacheSize = static_cast<unsigned>(opts.tileCacheMB) << 20;
+	}
+	return layout;
+}
+
 int
 main(int argc, char *argv[])
 {
 	dada2ms::options opts(argc, argv);
+	const std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
 
     // Assigning to local variables to make code below more readable
     dada::SortedDada dada(opts.dadaFile[0].c_str());
@@ -58,17 +122,32 @@ main(int argc, char *argv[])
     const double bw = dada.header.bandwidth();    // Bandwidth
     const double startTime = dada.header.startTimeMJD();
     const double finishTime = dada.header.finishTimeMJD();
-    const int nBaseline = dada.header.nBaseline(); // Including autocorrelations
 
     if (opts.firstOnly) {
     	nTime = 1;
     }
-    int outBaseline;
-    if (opts.autosOnly) {
-    	outBaseline = nAnt;
+
+    // Restrict the reorder to the selected channels and baselines
+    if (opts.lastChan >= 0) {
+    	dada.selectChannels(opts.firstChan, opts.lastChan - opts.firstChan + 1);
+    }
+    if (opts.autosOnly && opts.baselineAnt1.empty()) {
+    	dada.selectAutos();
     } else {
-    	outBaseline = nBaseline;
+    	dada.selectBaselines(opts.baselineAnt1, opts.baselineAnt2);
+    }
+    const int nSelFreq = dada.nOutFreq();
+    const double chanBW = bw / nFreq;
+    const double selCFreq = cFreq - bw / 2 + (dada.firstFreq() + nSelFreq / 2.0) * chanBW;
+    const double selBW = nSelFreq * chanBW;
+    // Channels written to the MS. The last averages fewer channels when
+    // --favg does not divide the selection.
+    const int nOutFreq = (nSelFreq + opts.freqAvg - 1) / opts.freqAvg;
+    if (nSelFreq % opts.freqAvg != 0) {
+    	std::cerr << "Warning: the last output channel averages " << nSelFreq % opts.freqAvg
+    	          << " channels rather than " << opts.freqAvg << std::endl;
     }
+    const int outBaseline = dada.nOutBaseline();
     MeasurementSet ms;
     MPosition arrPos(Quantity(opts.altitude, "m"), Quantity(opts.longitude, "deg"), Quantity(opts.latitude, "deg"), MPosition::WGS84);
     Matrix<Double> antPos = readAnts(opts.antFile.c_str(), nAnt);
@@ -77,15 +156,54 @@ main(int argc, char *argv[])
         updateObservationTab(ms.observation(), startTime, finishTime);
         updateSourceTab(ms.source(), startTime, finishTime);
         if (opts.addSPW) {
-        	int setSPW = fillSpWindowTab(ms.spectralWindow(), nFreq, cFreq, bw);
+        	int setSPW = fillSpWindowTab(ms.spectralWindow(), nSelFreq, selCFreq, selBW, opts.freqAvg);
         	opts.dataDescID = ms.dataDescription().nrow();
         	ms.dataDescription().addRow();
         	MSDataDescColumns cols(ms.dataDescription());
         	cols.spectralWindowId().put(opts.dataDescID, setSPW);
         }
     } else {
+        // Layout of the visibility columns, each tiled for its own value size
+        const ColumnLayout layout = visLayout(opts, nCorr, nOutFreq, outBaseline, 8 * sizeof(Complex));
+        const ColumnLayout flagLayout = visLayout(opts, nCorr, nOutFreq, outBaseline, 1); // Bool is stored as a bit
+        const ColumnLayout wtSpecLayout = visLayout(opts, nCorr, nOutFreq, outBaseline, 8 * sizeof(Float));
+        // TiledColumnStMan needs fixed shape columns
+        const bool fixedShape = layout.stMan == "tiledcolumn";
+        const IPosition visShape(2, nCorr, nOutFreq);
+
         // Create MS
-        SetupNewTable newTab(opts.msName, MS::requiredTableDesc(), Table::New);
+        const bool averaging = opts.timeAvg > 1 || opts.freqAvg > 1;
+        // With --compact, unit WEIGHT_SPECTRUM goes with WEIGHT and SIGMA
+        const bool incrWtSpec = opts.addWtSpec && opts.compact && !averaging;
+        TableDesc msDesc = MS::requiredTableDesc();
+        if (layout.bindFlag && fixedShape)
+        	msDesc.rwColumnDesc(MS::columnName(MS::FLAG)).setShape(visShape);
+        if (incrWtSpec)
+        	msDesc.addColumn(ArrayColumnDesc<Float>(MS::columnName(MS::WEIGHT_SPECTRUM), "The weight spectrum column",
+        	                                        visShape, ColumnDesc::FixedShape));
+        SetupNewTable newTab(opts.msName, msDesc, Table::New);
+        if (layout.bindFlag) {
+        	DataManager *flagStMan = layoutStMan(flagLayout, "flagHyperColumn");
+        	newTab.bindColumn(MS::columnName(MS::FLAG), *flagStMan);
+        	delete flagStMan;
+        }
+        IncrementalStMan incrStMan("ISMData");
+        if (opts.compact) {
+        	// Columns that only change between integrations (or never, as
+        	// the weights do without averaging) cost a value per change
+        	const MS::PredefinedColumns incrCols[] = {
+        		MS::TIME, MS::TIME_CENTROID, MS::INTERVAL, MS::EXPOSURE, MS::SCAN_NUMBER,
+        		MS::FIELD_ID, MS::DATA_DESC_ID, MS::ARRAY_ID, MS::OBSERVATION_ID, MS::PROCESSOR_ID,
+        		MS::STATE_ID, MS::FEED1, MS::FEED2, MS::FLAG_ROW};
+        	for (size_t c=0; c<sizeof(incrCols)/sizeof(incrCols[0]); ++c)
+        		newTab.bindColumn(MS::columnName(incrCols[c]), incrStMan);
+        	if (!averaging) {
+        		newTab.bindColumn(MS::columnName(MS::WEIGHT), incrStMan);
+        		newTab.bindColumn(MS::columnName(MS::SIGMA), incrStMan);
+        	}
+        	if (incrWtSpec)
+        		newTab.bindColumn(MS::columnName(MS::WEIGHT_SPECTRUM), incrStMan);
+        }
         ms = MeasurementSet(newTab);
         ms.createDefaultSubtables(Table::New);
 
@@ -101,7 +219,7 @@ main(int argc, char *argv[])
         fillObservationTab(ms.observation(), startTime, finishTime);
         fillPolarizationTab(ms.polarization());
         fillProcessorTab(ms.processor());
-        fillSpWindowTab(ms.spectralWindow(), nFreq, cFreq, bw);
+        fillSpWindowTab(ms.spectralWindow(), nSelFreq, selCFreq, selBW, opts.freqAvg);
         addSourceTab(ms);
         if (opts.azel) {
         	// NULL => zenith AZEL direction
@@ -112,75 +230,117 @@ main(int argc, char *argv[])
         fillPointingTab(ms.pointing(), nAnt, startTime, NULL);
 
         // Add DATA column
-        TiledShapeStMan dataStMan("dataHyperColumn", IPosition(2, nCorr, nFreq));
-        ArrayColumnDesc<Complex> dataColDesc(MS::columnName(MS::DATA), "The data column", 2);
-        ms.addColumn(dataColDesc, dataStMan);
-        if (opts.addWtSpec) {
-            TiledShapeStMan wtSpecStMan("weightSpecHyperColumn", IPosition(2, nCorr, nFreq));
-            ArrayColumnDesc<Float> wtSpecColDesc(MS::columnName(MS::WEIGHT_SPECTRUM), "The weight spectrum column", 2);
-            ms.addColumn(wtSpecColDesc, wtSpecStMan);
+        DataManager *dataStMan = layoutStMan(layout, "dataHyperColumn");
+        if (opts.compressData != "none") {
+        	addCompressedData(ms, opts.compressData, opts.compressBits, *dataStMan, visShape, fixedShape);
+        } else if (fixedShape) {
+        	ms.addColumn(ArrayColumnDesc<Complex>(MS::columnName(MS::DATA), "The data column", visShape,
+        	                                      ColumnDesc::FixedShape), *dataStMan);
+        } else {
+        	ms.addColumn(ArrayColumnDesc<Complex>(MS::columnName(MS::DATA), "The data column", 2), *dataStMan);
+        }
+        delete dataStMan;
+        if (opts.addWtSpec && !incrWtSpec) {
+            DataManager *wtSpecStMan = layoutStMan(wtSpecLayout, "weightSpecHyperColumn");
+            if (fixedShape) {
+            	ms.addColumn(ArrayColumnDesc<Float>(MS::columnName(MS::WEIGHT_SPECTRUM), "The weight spectrum column",
+            	                                    visShape, ColumnDesc::FixedShape), *wtSpecStMan);
+            } else {
+            	ms.addColumn(ArrayColumnDesc<Float>(MS::columnName(MS::WEIGHT_SPECTRUM), "The weight spectrum column", 2),
+            	             *wtSpecStMan);
+            }
+            delete wtSpecStMan;
         }
     }
 
     MSColumns msCols(ms);
-    int preexistingRows = ms.nrow();
     Int numFields = ms.field().nrow();
     Int firstScan = opts.startScan; // scan number of first scan in new data
     Int firstField = opts.startScan - 1;
 
     // Arrays for MS columns
-    Vector<Double> timeVals;
     Vector<Int> ant1Vals(outBaseline);
     Vector<Int> ant2Vals(outBaseline);
-    int bl = 0;
-    for (int i=0; i<nAnt; ++i) {
-    	for (int j=i; j<nAnt; ++j) {
-    		ant1Vals[bl] = i;
-    		ant2Vals[bl] = j;
-    		++bl;
-    	}
-    }
-    if (bl != outBaseline) {
-    	throw std::logic_error("Too many baselines internal error");
+    for (int bl=0; bl<outBaseline; ++bl) {
+    	ant1Vals[bl] = dada.outAnt1()[bl];
+    	ant2Vals[bl] = dada.outAnt2()[bl];
     }
 
-    // Optionally apply a simple (not time variable) CASA bandpass table
-    if (opts.applyCal) {
+    // Optionally apply a CASA gain table, with one or more solution times.
+    // With --cal-cache the tables are compiled (read and inverted) once and
+    // then used in place from the cache, which must outlive the conversion.
+    std::vector<dada::CalCache *> calCaches;
+    const dada::SortedDada::CalInterpolation calInterp = opts.calInterp == "nearest" ?
+    	dada::SortedDada::CAL_NEAREST : dada::SortedDada::CAL_LINEAR;
+    if (opts.applyCal && opts.calCache.empty()) {
+        std::vector<double> calTimes;
         std::vector<std::complex<float> > gain;
         std::vector<char> calFlag;
-    	readCalTable(opts.calTable.c_str(), gain, calFlag);
-    	dada.applyGains(gain, calFlag);
+    	readCalTable(opts.calTable.c_str(), calTimes, gain, calFlag);
+    	dada.applyGains(calTimes, gain, calFlag, calInterp);
+    } else if (opts.applyCal) {
+    	calCaches.push_back(compiledCal(opts.calCache, opts.calTable, 'G'));
+    	const dada::CalCache &cal = *calCaches.back();
+    	dada.applyInverseGains(cal.times(), cal.gains(), cal.flags(), cal.nGains(), calInterp);
     }
 
-    if (opts.applyTTCalBandpass) {
+    if (opts.applyTTCalBandpass && opts.calCache.empty()) {
         BCalTable bcal(opts.bcalTable.c_str());
         dada.applyGains(bcal.gains(),bcal.flags());
+    } else if (opts.applyTTCalBandpass) {
+    	calCaches.push_back(compiledCal(opts.calCache, opts.bcalTable, 'B'));
+    	const dada::CalCache &cal = *calCaches.back();
+    	dada.applyInverseGains(cal.times(), cal.gains(), cal.flags(), cal.nGains(), calInterp);
     }
 
-    if (opts.applyTTCalPolcal) {
+    if (opts.applyTTCalPolcal && opts.calCache.empty()) {
         JCalTable jcal(opts.jcalTable.c_str());
         dada.applyJones(jcal.gains(),jcal.flags());
+    } else if (opts.applyTTCalPolcal) {
+    	calCaches.push_back(compiledCal(opts.calCache, opts.jcalTable, 'J'));
+    	const dada::CalCache &cal = *calCaches.back();
+    	dada.applyInverseJones(cal.gains(), cal.flags(), cal.nFlags());
     }
 
     if (!opts.remapFile.empty()) {
         dada.setLineMappingFromFile(opts.remapFile.c_str());
     }
 
-    // We need to keep two copies of the flags due to the different storage (Bool vs char)
-    std::vector<char> &charFlags = dada.rCurrentVisFlags();
-    Cube<Bool> flag(nCorr, nFreq, outBaseline, false);
+    dada.setNumThreads(opts.numThreads);
+    if (opts.reader == "mmap") {
+        dada.setReadMode(dada::SortedDada::READ_MMAP);
+    } else if (opts.reader == "direct") {
+        dada.setReadMode(dada::SortedDada::READ_DIRECT);
+    }
+
+    // Flags of the current output integration. Calibration flags are only
+    // unpacked when the calibration changes them.
+    Cube<Bool> flag(nCorr, nOutFreq, outBaseline, false);
+    std::shared_ptr<const dada::FlagMask> unpackedFlags;
 
-    // Arrays common to all integrations
+    // UVWs. In J2000 mode they are towards each integration's zenith field,
+    // computed as it is written. In AZEL mode they are the local baselines,
+    // the same for every integration (or filled in at the end for ITRF
+    // antennas).
     Matrix<Double> uvws;
+    dada2ms::UVWEngine *uvwEngine = NULL;
     if (opts.autosOnly) {
     	uvws = Matrix<Double>(3, outBaseline, 0); // All zeros
-    } else {
-    	uvws = zenithUVWs(antPos);
+    } else if (!opts.azel) {
+    	const Matrix<Double> itrf = opts.antsAreITRF ? antPos :
+    		itrfAnts(antPos, opts.longitude, opts.latitude, opts.altitude);
+    	uvwEngine = new dada2ms::UVWEngine(itrf, ant1Vals, ant2Vals, arrPos);
+    } else if (!opts.antsAreITRF) {
+    	// zenithUVWs() covers every baseline, pick out the selected ones
+    	Matrix<Double> allUvws = zenithUVWs(antPos);
+    	uvws.resize(3, outBaseline);
+    	for (int bl=0; bl<outBaseline; ++bl) {
+    		int a1 = ant1Vals[bl];
+    		int full = a1 * nAnt - a1 * (a1 - 1) / 2 + ant2Vals[bl] - a1;
+    		uvws.column(bl) = allUvws.column(full);
+    	}
     }
-    Vector<Double> interval(outBaseline, intTime);
-    Matrix<Float> unity2d(nCorr, outBaseline, 1.0);
-    Cube<Float> unity3d(nCorr, nFreq, outBaseline, 1.0);
-    Vector<Int> dataDescVals(outBaseline, opts.dataDescID);
+    const bool unitWeights = opts.timeAvg == 1 && opts.freqAvg == 1;
 
     // opts.integrations holds the list of integrations to image
     if (opts.integrations.empty()) {
@@ -197,66 +357,167 @@ main(int argc, char *argv[])
         }
     }
 
-    // Add the integrations to the MS
-    for (int i=0; i<opts.integrations.size(); ++i) {
-    	int t = opts.integrations[i];
+    // Add the integrations to the MS, averaging opts.timeAvg at a time and
+    // opts.freqAvg channels together
+    const int nOutTime = (opts.integrations.size() + opts.timeAvg - 1) / opts.timeAvg;
+    Vector<Double> outTimes(nOutTime); // Mid-points of the output integrations
+    for (int i=0; i<nOutTime; ++i) {
+    	int t0 = opts.integrations[i * opts.timeAvg];
+    	int t1 = opts.integrations[std::min<int>((i + 1) * opts.timeAvg, opts.integrations.size()) - 1];
+    	outTimes[i] = startTime + ((t0 + t1) / 2.0 + 0.5) * intTime;
+    }
+    // The J2000 zenith of each output integration, its field and phase
+    // centre. A field is added for each whose field is not already in the
+    // table, all together.
+    const Vector<MDirection> zenithDirs = opts.azel ? Vector<MDirection>() : zenithDirections(arrPos, outTimes);
+    const int firstNew = std::max(numFields - firstField, 0);
+    if (!opts.azel && firstNew < nOutTime) {
+    	const Slice newFields(firstNew, nOutTime - firstNew);
+    	Vector<String> fieldNames(nOutTime - firstNew);
+    	for (int f=firstNew; f<nOutTime; ++f) {
+    		std::stringstream fieldName;
+    		fieldName << "Zenith" << fixed << std::setprecision(2) << outTimes[f];
+    		fieldNames[f - firstNew] = fieldName.str();
+    	}
+    	addFields(ms.field(), fieldNames, zenithDirs(newFields));
+    }
+    dada::ChunkPipeline pipeline(dada, opts.integrations, opts.queueDepth);
+    dada::VisAverager averager(outBaseline, nSelFreq, nCorr, opts.freqAvg);
+    Matrix<Float> avgWeight(nCorr, outBaseline), avgSigma(nCorr, outBaseline);
+    const bool writeUvw = !(opts.azel && opts.antsAreITRF);
+    // Integrations are written opts.batch at a time, the table growing by a
+    // batch per write
+    dada2ms::IntegrationWriter writer(ms, ant1Vals, ant2Vals, nOutFreq, nCorr, std::min(opts.batch, nOutTime),
+                                      unitWeights, writeUvw, opts.addWtSpec);
+    writer.setDataDescId(opts.dataDescID);
+    // Compression error of int16 DATA, from reading back what is written.
+    // Dysco keeps the rows being written uncompressed, so it cannot be
+    // measured that way.
+    const bool measureError = !opts.append && opts.compressData == "int16";
+    writer.setMeasureDataError(measureError);
+    for (int i=0; i<nOutTime; ++i) {
+    	int first = i * opts.timeAvg;
+    	int last = std::min<int>(first + opts.timeAvg, opts.integrations.size()) - 1;
+    	int t0 = opts.integrations[first];
+    	int t1 = opts.integrations[last];
     	int currField;
     	if (opts.azel) {
     		currField = firstField;
     	} else {
     		currField = firstField + i;
     	}
-    	Vector<Int> fieldVals(outBaseline, currField);
-    	Double currTime = startTime + (t + 0.5) * intTime;
-    	Vector<Double> timeVals(outBaseline, currTime);
-    	Vector<Int> scanVals(outBaseline, firstScan + i);
+    	Double currTime = outTimes[i];
+    	// With gaps in the selection the samples averaged are not centred on
+    	// the interval
+    	double meanInt = 0;
+    	for (int k=first; k<=last; ++k) {
+    		meanInt += opts.integrations[k];
+    	}
+    	meanInt /= last - first + 1;
+    	Double centroid = startTime + (meanInt + 0.5) * intTime;
 
-    	ms.addRow(outBaseline);
-    	Array<Complex> data(IPosition(3, nCorr, nFreq, outBaseline), dada.rGetChunk(t).data(), SHARE);
-        if (opts.applyCal || opts.applyTTCalBandpass || opts.applyTTCalPolcal) {
-    		charVector2boolArray(charFlags, flag);
+    	Complex *visData;
+    	Cube<Float> avgSpectrum; // Unused with unit weights
+    	if (opts.timeAvg == 1 && opts.freqAvg == 1) {
+    		dada::SortedChunk &chunk = pipeline.next();
+    		visData = chunk.data.data();
+    		if (chunk.flags != unpackedFlags) {
+    			if (chunk.flags)
+    				chunk.flags->unpack(flag.data());
+    			else
+    				flag = false;
+    			unpackedFlags = chunk.flags;
+    		}
+    	} else {
+    		averager.reset();
+    		for (int k=first; k<=last; ++k) {
+    			dada::SortedChunk &chunk = pipeline.next();
+    			averager.add(chunk.data.data(), chunk.flags.get());
+    			pipeline.release();
+    		}
+    		averager.finish();
+    		visData = averager.rData().data();
+    		averager.flags(flag.data());
+    		averager.rowWeights(avgWeight.data());
+    		for (Matrix<Float>::iterator w=avgWeight.begin(), s=avgSigma.begin(); w != avgWeight.end(); ++w, ++s) {
+    			*s = *w > 0 ? 1 / std::sqrt(*w) : 1;
+    		}
+    		avgSpectrum.takeStorage(IPosition(3, nCorr, nOutFreq, outBaseline), averager.rWeightSpectrum().data(), SHARE);
     	}
-        // Create a Slicer for the current integration
-        IPosition currIntStart(1, preexistingRows + i*outBaseline);
-        IPosition currIntLength(1,outBaseline);
-        IPosition currIntStride(1,1);
-        Slicer currIntSlicer(currIntStart, currIntLength, currIntStride);
-        if (!opts.antsAreITRF) {
-        	msCols.uvw().putColumnRange(currIntSlicer, uvws);
-        }
-        msCols.flag().putColumnRange(currIntSlicer, flag);
-        msCols.weight().putColumnRange(currIntSlicer, unity2d);
-        msCols.sigma().putColumnRange(currIntSlicer, unity2d);
-        msCols.antenna1().putColumnRange(currIntSlicer, ant1Vals);
-        msCols.antenna2().putColumnRange(currIntSlicer, ant2Vals);
-        msCols.dataDescId().putColumnRange(currIntSlicer, dataDescVals);
-        msCols.exposure().putColumnRange(currIntSlicer, interval);
-        msCols.fieldId().putColumnRange(currIntSlicer, fieldVals);
-        msCols.interval().putColumnRange(currIntSlicer, interval);
-        msCols.scanNumber().putColumnRange(currIntSlicer, scanVals);
-        msCols.time().putColumnRange(currIntSlicer, timeVals);
-        msCols.timeCentroid().putColumnRange(currIntSlicer, timeVals);
-        msCols.data().putColumnRange(currIntSlicer, data);
-        if (opts.addWtSpec) {
-            msCols.weightSpectrum().putColumnRange(currIntSlicer, unity3d);
-        }
-        if (!opts.azel && currField >= numFields) {
-        	std::stringstream fieldName;
-        	fieldName << "Zenith" << fixed << std::setprecision(2) << currTime;
-        	MDirection dir = getZenith(arrPos, MEpoch(Quantity(currTime, "s"), MEpoch::UTC));
-        	addField(ms.field(), fieldName.str(), &dir);
-        }
+    	Array<Complex> data(IPosition(3, nCorr, nOutFreq, outBaseline), visData, SHARE);
+    	if (uvwEngine) {
+    		uvwEngine->compute(currTime, zenithDirs[i], uvws);
+    	}
+    	writer.add(data, flag, uvws, avgWeight, avgSigma, avgSpectrum, currTime, centroid,
+    	           (t1 - t0 + 1) * intTime, (last - first + 1) * intTime, currField, firstScan + i);
+        pipeline.release();
+    }
+    writer.flush();
+    if (opts.printStats) {
+    	std::cerr << "Reorder kernels: " << dada::selectedSimdName() << std::endl;
+    	pipeline.printStats(std::cerr);
+    }
+    if (measureError) {
+    	std::cerr << "DATA compression error: at most " << writer.maxDataError() << " ("
+    	          << 100 * writer.maxRelDataError()
+    	          << "% of the largest part of a row)" << std::endl;
+    }
+    // Dysco's error cannot be measured, so it is estimated as half a uniform
+    // quantisation step of its levels. Dysco's levels are denser near zero
+    // and sparser in the tails, so this is only a guide, not a bound.
+    const bool estimateError = !opts.append && opts.compressData == "dysco";
+    const double estRelDataError = 1.0 / (1 << opts.compressBits);
+    if (estimateError) {
+    	std::cerr << "DATA compression error: not measured with dysco. Estimate from " << opts.compressBits
+    	          << " bits (" << (1 << opts.compressBits) << " levels per part): roughly "
+    	          << 100 * estRelDataError << "% of the largest part of a row" << std::endl;
     }
 
-    // FIXME: Currently broken
-    if (opts.antsAreITRF) {
+    // UVWs of every row from the ANTENNA and FIELD tables, as requested or
+    // when they could not be written with the data. FIXME: the latter (AZEL
+    // with ITRF antennas) is currently broken.
+    if (opts.remakeUvw || !writeUvw) {
     	MSUVWGenerator uvwGen(msCols, MBaseline::J2000, Muvw::J2000);
-    	Vector<Int> flds(nTime);
-    	for (int i=0; i<nTime; i++) {
+    	Vector<Int> flds(ms.field().nrow());
+    	for (uInt i=0; i<flds.nelements(); i++) {
     		flds(i) = i;
     	}
     	uvwGen.make_uvws(flds);
     }
 
+    if (!opts.statsFile.empty()) {
+    	// Throughput for tracking across builds, per input integration
+    	const double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    	const double nInt = opts.integrations.size();
+    	const double inBytes = dada.header.bytesPerAvg();
+    	const double outBytes = static_cast<double>(outBaseline) * nSelFreq * nCorr * sizeof(Complex);
+    	std::ofstream stats(opts.statsFile.c_str());
+    	stats << "{\"dada\": " << dada::jsonString(opts.dadaFile[0]) << ", \"antennas\": " << nAnt
+    	      << ", \"channels\": " << nSelFreq << ", \"baselines\": " << outBaseline
+    	      << ", \"integrations\": " << opts.integrations.size()
+    	      << ", \"options\": {\"threads\": " << opts.numThreads << ", \"queue_depth\": " << opts.queueDepth
+    	      << ", \"reader\": " << dada::jsonString(opts.reader) << ", \"batch\": " << opts.batch
+    	      << ", \"simd\": " << dada::jsonString(dada::selectedSimdName())
+    	      << ", \"layout\": " << dada::jsonString(opts.layout)
+    	      << ", \"compress_data\": " << dada::jsonString(opts.compressData) << "}";
+    	if (measureError) {
+    		stats << ", \"data_error_max\": " << writer.maxDataError()
+    		      << ", \"data_rel_error_max\": " << writer.maxRelDataError();
+    	} else if (estimateError) {
+    		stats << ", \"data_rel_error_estimate\": " << estRelDataError;
+    	}
+    	stats << ", \"input_bytes\": " << nInt * inBytes << ", \"output_bytes\": " << nInt * outBytes
+    	      << ", \"wall_s\": " << wall << ", \"mb_per_s\": " << dada::jsonRate(nInt * inBytes / 1e6, wall)
+    	      << ", \"ints_per_s\": " << dada::jsonRate(nInt, wall) << ", \"stages\": ";
+    	pipeline.printStatsJson(stats, inBytes, outBytes);
+    	stats << "}" << std::endl;
+    	if (!stats) {
+    		throw std::runtime_error("Error writing " + opts.statsFile);
+    	}
+    }
+
+    delete uvwEngine;
+    for (size_t i=0; i<calCaches.size(); ++i)
+    	delete calCaches[i];
     return 0;
 }
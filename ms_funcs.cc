@@ -18,6 +18,8 @@
 #include <casa/Arrays.h>
 #include <tables/Tables.h>
 #include <ms/MeasurementSets.h>
+#include <tables/Tables/CompressComplex.h>
+#include <tables/Tables/DataManager.h>
 
 using namespace casa;
 
@@ -46,6 +48,25 @@ getZenith(const MPosition &pos, const MEpoch &epoch)
 
 }
 
+// J2000 directions of the zenith at pos at each of times (MJD seconds, UTC).
+// One frame and conversion engine serve all the times, only the frame's
+// epoch changes between them.
+Vector<MDirection>
+zenithDirections(const MPosition &pos, const Vector<Double> &times)
+{
+    Vector<MDirection> dirs(times.nelements());
+    if (times.empty())
+        return dirs;
+    MeasFrame frame(MEpoch(Quantity(times(0), "s"), MEpoch::UTC), pos);
+    MDirection::Convert toJ2000(MDirection::Ref(MDirection::AZEL, frame), MDirection::Ref(MDirection::J2000));
+    const MVDirection up(Quantity(0.0, "deg"), Quantity(90.0, "deg"));
+    for (uInt i=0; i<times.nelements(); ++i) {
+        frame.resetEpoch(MVEpoch(Quantity(times(i), "s")));
+        dirs(i) = toJ2000(up);
+    }
+    return dirs;
+}
+
 inline double
 radians(double degrees)
 {
@@ -240,6 +261,45 @@ addField(MSField &field, const String &name, MDirection *dir)
 	return 0;
 }
 
+// Add a field for each of names with the direction in dirs, growing the
+// table once and writing each column for all of them with one put
+int
+addFields(MSField &field, const Vector<String> &names, const Vector<MDirection> &dirs)
+{
+	const uInt n = names.nelements();
+	if (dirs.nelements() != n)
+		throw std::length_error("names and directions differ in length in addFields()");
+	if (n == 0)
+		return 0;
+	MSFieldColumns cols(field);
+	const uInt first = field.nrow();
+	field.addRow(n);
+	const Slicer rows(IPosition(1, first), IPosition(1, n));
+	cols.name().putColumnRange(rows, names);
+	cols.sourceId().putColumnRange(rows, Vector<Int>(n, 0));
+	const MDirection::Types ref = MDirection::castType(dirs(0).getRef().getType());
+	if (!cols.phaseDirMeasCol().isRefVariable() &&
+	    cols.phaseDirMeasCol().getMeasRef().getType() == static_cast<uInt>(ref)) {
+		// The directions are in the columns' frame, so their angles can be
+		// written as they are
+		Cube<Double> angles(2, 1, n);
+		for (uInt i=0; i<n; ++i)
+			angles.xyPlane(i).column(0) = dirs(i).getValue().get();
+		cols.delayDir().putColumnRange(rows, angles);
+		cols.phaseDir().putColumnRange(rows, angles);
+		cols.referenceDir().putColumnRange(rows, angles);
+	} else {
+		for (uInt i=0; i<n; ++i) {
+			const Vector<MDirection> dirVector(1, dirs(i));
+			cols.delayDirMeasCol().put(first + i, dirVector);
+			cols.phaseDirMeasCol().put(first + i, dirVector);
+			cols.referenceDirMeasCol().put(first + i, dirVector);
+		}
+	}
+
+	return 0;
+}
+
 int
 fillObservationTab(MSObservation &observation, Double startTime, Double finishTime)
 {
@@ -323,19 +383,25 @@ fillProcessorTab(MSProcessor &processor)
 }
 
 int
-fillSpWindowTab(MSSpectralWindow &spw, int nFreq, double cFreq, double bw)
+fillSpWindowTab(MSSpectralWindow &spw, int nFreq, double cFreq, double bw, int chanAvg)
 {
 	int currRow = spw.nrow();
     spw.addRow();
     MSSpWindowColumns cols(spw);
 
+    // nFreq channels across bw, written as groups of chanAvg. The last group
+    // is narrower when chanAvg does not divide nFreq.
     double refFreq = cFreq - bw / 2;
     double chanBW = bw / nFreq;
-    Vector<Double> chanFreq(nFreq);
-    for (int i=0; i<nFreq; i++) {
-        chanFreq[i] = refFreq + (i+0.5) * chanBW;
+    const int nOutFreq = (nFreq + chanAvg - 1) / chanAvg;
+    Vector<Double> chanFreq(nOutFreq);
+    Vector<Double> vChanBW(nOutFreq);
+    for (int i=0; i<nOutFreq; i++) {
+        const int first = i * chanAvg;
+        const int n = std::min(chanAvg, nFreq - first);
+        chanFreq[i] = refFreq + (first + n / 2.0) * chanBW;
+        vChanBW[i] = n * chanBW;
     }
-    Vector<Double> vChanBW(nFreq, chanBW);
     cols.measFreqRef().put(currRow, 1);
     cols.chanFreq().put(currRow, chanFreq);
     cols.refFrequency().put(currRow, refFreq);
@@ -347,7 +413,7 @@ fillSpWindowTab(MSSpectralWindow &spw, int nFreq, double cFreq, double bw)
     s << cFreq;
     cols.name().put(currRow, s.str().c_str());
     cols.netSideband().put(currRow, 1);
-    cols.numChan().put(currRow, nFreq);
+    cols.numChan().put(currRow, nOutFreq);
     cols.totalBandwidth().put(currRow, bw);
 
     return currRow;
@@ -415,6 +481,120 @@ updateObservationTab(MSObservation &observation, Double startTime, Double finish
     return 0;
 }
 
+// Presets for the layout of the visibility columns:
+//   default:  DATA tiled by whole rows, FLAG in the StandardStMan
+//   write:    tiles of whole rows (about 1 MiB), so each integration
+//             completes tiles in order and nothing is revisited. Where a
+//             divisor of nBaseline keeps them at least half that size, the
+//             tiles hold that many rows so integrations end on tile
+//             boundaries.
+//   baseline: small tiles of whole rows (about 64 kiB), so reading one
+//             baseline reads little else
+//   channel:  tiles of 4 channels over many rows (about 1 MiB), so reading
+//             one channel reads about 4/nFreq of the column. The cache holds
+//             the tiles of two row blocks, as every integration touches all
+//             channel tiles of its rows.
+// Tile sizes are for a column of elementBits per value as stored. The tiled
+// storage managers keep Bool as one bit, so FLAG (elementBits 1) gets tiles
+// of as many bytes as DATA rather than a sixty-fourth.
+ColumnLayout
+columnLayout(const std::string &preset, int nCorr, int nFreq, int nBaseline, int elementBits)
+{
+	ColumnLayout layout;
+	layout.stMan = "tiledshape";
+	layout.bucketSize = 0;
+	layout.cacheSize = 0;
+	layout.bindFlag = true;
+	if (preset == "default") {
+		layout.tileShape = IPosition(2, nCorr, nFreq);
+		layout.bindFlag = false;
+	} else if (preset == "write" || preset == "baseline") {
+		const int tileBits = 8 * (preset == "write" ? 1 << 20 : 64 << 10);
+		int rows = std::max(1, std::min(nBaseline, tileBits / (nCorr * nFreq * elementBits)));
+		if (preset == "write") {
+			int divisor = rows;
+			while (nBaseline % divisor != 0)
+				--divisor;
+			if (2 * divisor >= rows)
+				rows = divisor;
+		}
+		layout.tileShape = IPosition(3, nCorr, nFreq, rows);
+	} else if (preset == "channel") {
+		const int chans = std::min(nFreq, 4);
+		const int rows = std::max(1, 8 * (1 << 20) / (nCorr * chans * elementBits));
+		layout.tileShape = IPosition(3, nCorr, chans, rows);
+		const int freqTiles = (nFreq + chans - 1) / chans;
+		const unsigned tileBytes = (static_cast<unsigned>(rows) * nCorr * chans * elementBits + 7) / 8;
+		layout.cacheSize = 2u * freqTiles * tileBytes;
+	} else {
+		throw std::invalid_argument("Unknown column layout " + preset);
+	}
+	return layout;
+}
+
+// A storage manager for one visibility column laid out as layout. The
+// caller owns it; binding a column clones it.
+DataManager *
+layoutStMan(const ColumnLayout &layout, const String &name)
+{
+	if (layout.stMan == "tiledcolumn")
+		return new TiledColumnStMan(name, layout.tileShape, layout.cacheSize);
+	if (layout.stMan == "standard")
+		return new StandardStMan(name, layout.bucketSize);
+	return new TiledShapeStMan(name, layout.tileShape, layout.cacheSize);
+}
+
+// Add a lossy compressed DATA column to a new MS, read as ordinary Complex
+// data. method "int16" stores each real and imaginary part as a 16-bit
+// integer scaled to the range of its row (one baseline of one integration)
+// with casacore's CompressComplex engine, so every casacore reader handles
+// it; the integers go in DATA_COMPRESSED using stMan, the row scales and
+// offsets in DATA_SCALE and DATA_OFFSET. method "dysco" uses the Dysco
+// storage manager (which readers also need) with bits per value and row
+// normalisation; it is loaded through the casacore data manager registry.
+// shape is the shape of a DATA cell.
+void
+addCompressedData(MeasurementSet &ms, const std::string &method, int bits, const DataManager &stMan,
+                  const IPosition &shape, bool fixedShape)
+{
+	const String dataName = MS::columnName(MS::DATA);
+	if (method == "dysco") {
+		Record spec;
+		spec.define("dataBitCount", bits);
+		spec.define("weightBitCount", 12);
+		spec.define("distribution", "TruncatedGaussian");
+		spec.define("distributionTruncation", 2.5);
+		spec.define("normalization", "Row");
+		spec.define("studentTNu", 0.0);
+		// Throws if the Dysco library cannot be found
+		DataManager *dysco = DataManager::getCtor("DyscoStMan")("dyscoData", spec);
+		ms.addColumn(ArrayColumnDesc<Complex>(dataName, "The data column", shape, ColumnDesc::FixedShape), *dysco);
+		delete dysco;
+		return;
+	}
+	if (method != "int16")
+		throw std::invalid_argument("Unknown DATA compression " + method);
+	const String storedName = dataName + "_COMPRESSED";
+	const String scaleName = dataName + "_SCALE";
+	const String offsetName = dataName + "_OFFSET";
+	if (fixedShape) {
+		ms.addColumn(ArrayColumnDesc<Int>(storedName, "DATA as scaled 16-bit integers", shape, ColumnDesc::FixedShape), stMan);
+	} else {
+		ms.addColumn(ArrayColumnDesc<Int>(storedName, "DATA as scaled 16-bit integers", 2), stMan);
+	}
+	TableDesc scaleDesc;
+	scaleDesc.addColumn(ScalarColumnDesc<Float>(scaleName, "Scale of DATA_COMPRESSED"));
+	scaleDesc.addColumn(ScalarColumnDesc<Float>(offsetName, "Offset of DATA_COMPRESSED"));
+	StandardStMan scaleStMan("dataScale");
+	ms.addColumn(scaleDesc, scaleStMan);
+	CompressComplex engine(dataName, storedName, scaleName, offsetName, True);
+	if (fixedShape) {
+		ms.addColumn(ArrayColumnDesc<Complex>(dataName, "The data column", shape, ColumnDesc::FixedShape), engine);
+	} else {
+		ms.addColumn(ArrayColumnDesc<Complex>(dataName, "The data column", 2), engine);
+	}
+}
+
 void
 boolArray2charVector(Array<Bool> &boolArr, std::vector<char> &charVec)
 {
@@ -436,7 +616,8 @@ charVector2boolArray(std::vector<char> &charVec, Array<Bool> &boolArr)
 }
 
 void
-readCalTable(const char *calName, std::vector<std::complex<float> > &gain, std::vector<char> &flag)
+readCalTable(const char *calName, std::vector<double> &times, std::vector<std::complex<float> > &gain,
+             std::vector<char> &flag)
 {
     const Table cal(calName, Table::Old);
     const int nrow = cal.nrow();
@@ -452,11 +633,20 @@ readCalTable(const char *calName, std::vector<std::complex<float> > &gain, std::
     Array<Bool> arr_flag = ROArrayColumn<Bool>(cal, "FLAG").getColumn();
     boolArray2charVector(arr_flag, flag);
 
-    // Check for "simple" table, one row per antenna
+    // Check for "simple" table, one row per antenna for each solution time,
+    // so the gains are [time][ant][chan][pol]
     ROScalarColumn<Int> antenna1(cal, "ANTENNA1");
+    ROScalarColumn<Double> time(cal, "TIME");
+    int nAnt = 0;
+    while (nAnt < nrow && time.get(nAnt) == time.get(0))
+        nAnt++;
+    if (nrow % nAnt != 0)
+        throw std::length_error("Cal table not expected shape (one row per ant per time)");
+    times.resize(nrow / nAnt);
     for (int i=0; i<nrow; i++) {
-        if(antenna1.get(i) != i)
-		throw std::length_error("Cal table not expected shape (one row per ant)");
+        if (antenna1.get(i) != i % nAnt || time.get(i) != time.get(i - i % nAnt))
+		throw std::length_error("Cal table not expected shape (one row per ant per time)");
+        times[i / nAnt] = time.get(i);
     }
 }
 
@@ -25,8 +25,18 @@
 #define ANTENNA_DISH_DIAMETER 2.0
 #define DEFAULT_INT_TIME 8.33
 
+// Storage of the DATA, FLAG and WEIGHT_SPECTRUM columns of a new MS
+struct ColumnLayout {
+    std::string stMan;         // "tiledshape", "tiledcolumn" or "standard"
+    casa::IPosition tileShape; // [corr, freq, row] for the tiled managers
+    int bucketSize;            // StandardStMan bucket size in bytes, 0 => casacore default
+    unsigned cacheSize;        // Maximum tile cache in bytes, 0 => no limit
+    bool bindFlag;             // Store FLAG like DATA (otherwise the default StandardStMan)
+};
+
 casa::MEpoch str2MEpoch(const char *time, double offset);
 casa::MDirection getZenith(const casa::MPosition &pos, const casa::MEpoch &epoch);
+casa::Vector<casa::MDirection> zenithDirections(const casa::MPosition &pos, const casa::Vector<casa::Double> &times);
 inline double radians(double degrees);
 double seaLevel(double latitude);
 casa::Matrix<double> readAnts(const char *filename, int nAnt);
@@ -37,16 +47,23 @@ int fillAntTab(casa::MSAntenna &ant, int nAnt, casa::Matrix<double> itrfPos);
 int fillFeedTab(casa::MSFeed &feed, int nAnt);
 int fillFieldTab(casa::MSField &field, const casa::MDirection *dir);
 int addField(casa::MSField &field, const casa::String &name, casa::MDirection *dir);
+int addFields(casa::MSField &field, const casa::Vector<casa::String> &names,
+              const casa::Vector<casa::MDirection> &dirs);
 int fillObservationTab(casa::MSObservation &observation, double startTime, double finishTime);
 int fillPointingTab(casa::MSPointing &pointing, int nAnt, double time, const casa::MDirection *dir);
 int fillPolarizationTab(casa::MSPolarization &polarization);
 int fillProcessorTab(casa::MSProcessor &processor);
-int fillSpWindowTab(casa::MSSpectralWindow &spw, int nFreq, double cFreq, double bw);
+int fillSpWindowTab(casa::MSSpectralWindow &spw, int nFreq, double cFreq, double bw, int chanAvg = 1);
 int fillSourceTab(casa::MSSource &source, double startTime, double finishTime, const casa::MDirection *dir);
 int updateSourceTab(casa::MSSource &source, double startTime, double finishTime);
 int updateObservationTab(casa::MSObservation &observation, double startTime, double finishTime);
+ColumnLayout columnLayout(const std::string &preset, int nCorr, int nFreq, int nBaseline, int elementBits);
+casa::DataManager *layoutStMan(const ColumnLayout &layout, const casa::String &name);
+void addCompressedData(casa::MeasurementSet &ms, const std::string &method, int bits,
+                       const casa::DataManager &stMan, const casa::IPosition &shape, bool fixedShape);
 void boolArray2charVector(casa::Array<casa::Bool> &boolArr, std::vector<char> &charVec);
 void charVector2boolArray(std::vector<char> &charVec, casa::Array<casa::Bool> &boolArr);
-void readCalTable(const char *calName, std::vector<std::complex<float> > &gain, std::vector<char> &flag);
+void readCalTable(const char *calName, std::vector<double> &times, std::vector<std::complex<float> > &gain,
+                  std::vector<char> &flag);
 
 #endif /* MS_FUNCS_H_ */
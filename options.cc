@@ -9,6 +9,9 @@
 #include <cstdlib>
 #include <string>
 #include <sstream>
+#include <set>
+#include <algorithm>
+#include <utility>
 
 namespace dada2ms {
 
@@ -26,9 +29,26 @@ options::options(int argc, char *argv[]) :
     addSPW(false),
     applyCal(false),
     antsAreITRF(false),
+    printStats(false),
+    compact(false),
+    remakeUvw(false),
     dataDescID(0),
     startScan(1),
-    configFile(default_config_file)
+    numThreads(1),
+    queueDepth(0),
+    batch(1),
+    timeAvg(1),
+    freqAvg(1),
+    firstChan(0),
+    lastChan(-1),
+    bucketSize(0),
+    tileCacheMB(-1),
+    compressBits(10),
+    configFile(default_config_file),
+    calInterp("linear"),
+    reader("stream"),
+    layout("default"),
+    compressData("none")
 {
     namespace po = boost::program_options;
     po::options_description poGeneric("Generic options");
@@ -39,13 +59,58 @@ options::options(int argc, char *argv[]) :
         ("append", po::bool_switch(&append), "append to MS (otherwise overwrite)")
         ("first", po::bool_switch(&firstOnly), "output first integration only")
         ("ints", po::value<std::string>(), "Integrations to take")
-        //Not longer implemented ("autos", po::bool_switch(&autosOnly), "output auto-correlations only")
+        ("autos", po::bool_switch(&autosOnly), "output auto-correlations only. With --baselines/--ants, "
+                  "only the auto-correlations of those antennas")
         ("azel", po::bool_switch(&azel), "Use AZEL reference for directions. "
                   "Otherwise J2000 is used.")
         ("wtspec", po::bool_switch(&addWtSpec), "create a WEIGHT_SPECTRUM column.")
+        ("compact", po::bool_switch(&compact), "store TIME, SCAN_NUMBER, FIELD_ID and other columns that only "
+                  "change between integrations (and the unit weights when not averaging) with IncrementalStMan, "
+                  "which stores a value only where it differs from the previous row. Only used when creating an MS.")
+        ("remake-uvw", po::bool_switch(&remakeUvw), "recompute the UVWs of every row of the MS (eg one "
+                  "appended to) from the ANTENNA and FIELD tables once the conversion is done. Not with --azel")
         ("addspw", po::bool_switch(&addSPW), "create and use a new SPW for these data. Only used with --append.")
         ("ddid", po::value<int>(&dataDescID), "use the specified pre-existing DATA_DESC_ID for these data. Only used with --append. Overridden by --addSPW. Default: 0")
         ("startscan", po::value<int>(&startScan), "use this value as the first scan/field value. Default: 1")
+        ("threads", po::value<int>(&numThreads), "number of threads used to reorder each integration. Default: 1")
+        ("queue-depth", po::value<int>(&queueDepth), "read and reorder up to this many integrations ahead "
+                  "of the MS writer on separate threads. 0 disables the pipeline. Default: 0")
+        ("batch", po::value<int>(&batch), "write this many (output) integrations to the MS at a time, "
+                  "each column in one put, adding their rows to the MS together. "
+                  "Memory use grows with the batch. Default: 1")
+        ("tavg", po::value<int>(&timeAvg), "average this many consecutive integrations (of those selected) "
+                  "into each output integration. Default: 1")
+        ("favg", po::value<int>(&freqAvg), "average groups of this many adjacent channels. If it does not "
+                  "divide the number of channels, the last output channel averages the remainder. Default: 1")
+        ("chans", po::value<std::string>(), "convert only channels a to b inclusive, given as a:b "
+                  "(counting from 0)")
+        ("baselines", po::value<std::string>(), "convert only these baselines, given as antenna pairs "
+                  "a-b,c-d,... (antenna numbers as in the MS, counting from 0)")
+        ("ants", po::value<std::string>(), "convert only baselines between these antennas, given as a,b,... "
+                  "Combined with --baselines if both are given")
+        ("layout", po::value<std::string>(&layout), "storage layout of DATA, FLAG and WEIGHT_SPECTRUM in a new MS: "
+                  "default (DATA tiled by rows, FLAG unbound), write (~1 MiB tiles of whole rows), baseline "
+                  "(~64 kiB tiles of whole rows) or channel (4 channel tiles over many rows, for per-channel "
+                  "readers). Default: default")
+        ("data-stman", po::value<std::string>(&dataStMan), "storage manager for the visibility columns: "
+                  "tiledshape, tiledcolumn or standard. Overrides --layout")
+        ("tile-shape", po::value<std::string>(), "tile shape of the visibility columns as corr,chan,rows. "
+                  "Overrides --layout")
+        ("bucket-size", po::value<int>(&bucketSize), "StandardStMan bucket size in bytes with --data-stman standard")
+        ("tile-cache", po::value<int>(&tileCacheMB), "maximum tile cache of the visibility columns in MiB "
+                  "(0 => no limit). Overrides --layout")
+        ("compress-data", po::value<std::string>(&compressData), "lossy compression of DATA in a new MS: "
+                  "none, int16 (16-bit integers scaled per row with casacore's CompressComplex, readable by "
+                  "any casacore program; the largest error is printed at the end) or dysco (the Dysco "
+                  "storage manager, which readers also need; its error cannot be measured, so an estimate from "
+                  "--compress-bits is printed instead). Default: none")
+        ("compress-bits", po::value<int>(&compressBits), "bits per value with --compress-data dysco. Default: 10")
+        ("stats", po::bool_switch(&printStats), "print per-stage timing and stall counters")
+        ("stats-json", po::value<std::string>(&statsFile), "write the run's configuration, overall and "
+                  "per-stage throughput (MB/s, integrations/s) and stall counters to this file as JSON")
+        ("reader", po::value<std::string>(&reader), "how to read the dada file: stream (read each integration), "
+                  "mmap (gather from a memory map, best for files in the page cache) "
+                  "or direct (large O_DIRECT reads in flight, best for cold files). Default: stream")
     ;
     po::options_description poConfig("Configuration options");
     poConfig.add_options()
@@ -56,9 +121,13 @@ options::options(int argc, char *argv[]) :
         // Currently disabled as untested ("itrfant", po::value<std::string>(), "antenna ITRF positions (m)")
         ("remap", po::value<std::string>(&remapFile), "remap lines as per file")
         ("cal", po::value<std::string>(&calTable), "Calibrate with CASA Bandpass table")
+        ("cal-interp", po::value<std::string>(&calInterp), "interpolation between the solutions of a time "
+            "variable --cal table: nearest or linear (in amplitude and phase, as CASA does; default)")
         // TTCal calibration options
         ("ttcal-bandpass", po::value<std::string>(&bcalTable), "Calibrate with a TTCal bandpass file")
         ("ttcal-polcal", po::value<std::string>(&jcalTable), "Calibrate with a TTCal polcal file")
+        ("cal-cache", po::value<std::string>(&calCache), "directory of compiled calibration tables, shared "
+            "by conversions using the same tables")
     ;
     po::options_description poHidden("Hidden options");
     poHidden.add_options()
@@ -113,11 +182,124 @@ options::options(int argc, char *argv[]) :
             exit(EXIT_FAILURE);
         }
     }
+    if (remakeUvw && azel) {
+        std::cerr << "Error: --remake-uvw cannot be used with --azel" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (reader != "stream" && reader != "mmap" && reader != "direct") {
+        std::cerr << "Error: --reader must be stream, mmap or direct" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (layout != "default" && layout != "write" && layout != "baseline" && layout != "channel") {
+        std::cerr << "Error: --layout must be default, write, baseline or channel" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (!dataStMan.empty() && dataStMan != "tiledshape" && dataStMan != "tiledcolumn" && dataStMan != "standard") {
+        std::cerr << "Error: --data-stman must be tiledshape, tiledcolumn or standard" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (args.count("tile-shape")) {
+        tileShape = split<int>(args["tile-shape"].as<std::string>(), ',');
+        if (tileShape.size() != 3 || *std::min_element(tileShape.begin(), tileShape.end()) < 1) {
+            std::cerr << "Error: --tile-shape must be three positive sizes corr,chan,rows" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (compressData != "none" && compressData != "int16" && compressData != "dysco") {
+        std::cerr << "Error: --compress-data must be none, int16 or dysco" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (compressBits < 2 || compressBits > 16) {
+        std::cerr << "Error: --compress-bits must be from 2 to 16" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (tileCacheMB > 4095) {
+        std::cerr << "Error: --tile-cache must be less than 4096 MiB" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (bucketSize < 0) {
+        std::cerr << "Error: --bucket-size must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (timeAvg < 1) {
+        std::cerr << "Error: --tavg must be at least 1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (freqAvg < 1) {
+        std::cerr << "Error: --favg must be at least 1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (batch < 1) {
+        std::cerr << "Error: --batch must be at least 1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (queueDepth < 0) {
+        std::cerr << "Error: --queue-depth must not be negative" << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    if (numThreads < 1) {
+        std::cerr << "Error: --threads must be at least 1" << std::endl;
+        exit(EXIT_FAILURE);
+    }
     if (args.count("ints"))
         integrations = split<int>(args["ints"].as<std::string>(), ',');
+    if (args.count("chans")) {
+        std::vector<int> chans = split<int>(args["chans"].as<std::string>(), ':');
+        if (chans.size() != 2 || chans[0] < 0 || chans[1] < chans[0]) {
+            std::cerr << "Error: --chans must be a:b with 0 <= a <= b" << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        firstChan = chans[0];
+        lastChan = chans[1];
+    }
+    std::set<std::pair<int, int> > baselines;
+    if (args.count("baselines")) {
+        std::stringstream ss(args["baselines"].as<std::string>());
+        std::string pair;
+        while (std::getline(ss, pair, ',')) {
+            std::vector<int> ants = split<int>(pair, '-');
+            if (ants.size() != 2 || ants[0] < 0 || ants[1] < 0) {
+                std::cerr << "Error: invalid baseline " << pair << " in --baselines" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            baselines.insert(std::make_pair(std::min(ants[0], ants[1]), std::max(ants[0], ants[1])));
+        }
+    }
+    if (args.count("ants")) {
+        std::vector<int> ants = split<int>(args["ants"].as<std::string>(), ',');
+        for (size_t i=0; i<ants.size(); ++i) {
+            if (ants[i] < 0) {
+                std::cerr << "Error: invalid antenna in --ants" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            for (size_t j=0; j<ants.size(); ++j) {
+                if (ants[i] <= ants[j])
+                    baselines.insert(std::make_pair(ants[i], ants[j]));
+            }
+        }
+    }
+    if (autosOnly) {
+        // The auto-correlations of every antenna named in the selection
+        std::set<int> autoAnts;
+        for (std::set<std::pair<int, int> >::const_iterator it=baselines.begin(); it!=baselines.end(); ++it) {
+            autoAnts.insert(it->first);
+            autoAnts.insert(it->second);
+        }
+        baselines.clear();
+        for (std::set<int>::const_iterator it=autoAnts.begin(); it!=autoAnts.end(); ++it)
+            baselines.insert(std::make_pair(*it, *it));
+    }
+    for (std::set<std::pair<int, int> >::const_iterator it=baselines.begin(); it!=baselines.end(); ++it) {
+        baselineAnt1.push_back(it->first);
+        baselineAnt2.push_back(it->second);
+    }
 
     if (args.count("cal"))
         applyCal = true;
+    if (calInterp != "nearest" && calInterp != "linear") {
+        std::cerr << "Error: --cal-interp must be nearest or linear" << std::endl;
+        exit(EXIT_FAILURE);
+    }
 
     if (args.count("ttcal-bandpass"))
         applyTTCalBandpass = true;
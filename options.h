@@ -25,19 +25,42 @@ struct options {
     bool applyTTCalBandpass; // Apply existing TTCal bandpass calibration
     bool applyTTCalPolcal;   // Apply existing TTCal polcal calibration
 	bool antsAreITRF;  // Antenna positions are ITRF (default is relative to array position)
+	bool printStats;   // Print per-stage timing at the end
+	bool compact;      // Store per-integration constant columns with IncrementalStMan
+	bool remakeUvw;    // Recompute the UVWs of the whole MS at the end
 
 	int dataDescID;
 	int startScan;
+	int numThreads;    // Threads used to reorder each integration
+	int queueDepth;    // Integrations read/sorted ahead of the writer (0 => no pipelining)
+	int batch;         // Output integrations written to the MS at a time
+	int timeAvg;       // Number of integrations averaged into each output integration
+	int freqAvg;       // Number of channels averaged into each output channel
+	int firstChan;     // First channel to convert
+	int lastChan;      // Last channel to convert (-1 => last in the file)
+	int bucketSize;    // StandardStMan bucket size in bytes (0 => from layout)
+	int tileCacheMB;   // Maximum tile cache of tiled columns in MiB (-1 => from layout, 0 => no limit)
+	int compressBits;  // Bits per value of Dysco compressed DATA
 
 	std::string configFile;
 	std::string remapFile;
 	std::string calTable;
+	std::string calInterp; // Interpolation of time variable CASA gains: "nearest" or "linear"
+	std::string calCache;  // Directory of compiled calibration tables (empty => not cached)
 	std::string bcalTable; // TTCal bandpass calibration
 	std::string jcalTable; // TTCal polcal calibration
 	std::string antFile;
 	std::string msName;
+	std::string reader;    // How integrations are read: "stream", "mmap" or "direct"
+	std::string layout;    // Preset layout of the visibility columns of a new MS
+	std::string dataStMan; // Storage manager of the visibility columns (empty => from layout)
+	std::string compressData; // Lossy DATA compression: "none", "int16" or "dysco"
+	std::string statsFile; // Where to write the timing as JSON (empty => not written)
 
 	std::vector<int> integrations;
+	std::vector<int> tileShape;    // Tile shape [corr, freq, row] (empty => from layout)
+	std::vector<int> baselineAnt1; // Baselines to convert, sorted (empty => all)
+	std::vector<int> baselineAnt2;
 	std::vector<std::string> dadaFile;
 
 	options(int argc, char *argv[]);
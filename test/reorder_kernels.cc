@@ -0,0 +1,141 @@
+//
+// Check that every vectorised reorder and calibration kernel this CPU can run
+// gives bit-identical results to its scalar version, on random data covering
+// both run patterns and channel counts that leave a tail for each vector
+// width.
+//
+// From the top directory:
+// g++ -O3 -I. -o reorder_kernels test/reorder_kernels.cc ReorderKernels.cc
+//
+
+#include "ReorderKernels.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace dada;
+
+static int failures = 0;
+
+static float randomFloat()
+{
+    return rand() / static_cast<float>(RAND_MAX) * 2.0f - 1.0f;
+}
+
+static std::vector<float> randomFloats(size_t n)
+{
+    std::vector<float> values(n);
+    for (size_t k=0; k<n; ++k)
+        values[k] = randomFloat();
+    return values;
+}
+
+static void check(const std::string &name, const std::vector<float> &expected, const std::vector<float> &got)
+{
+    if (memcmp(expected.data(), got.data(), expected.size() * sizeof(float)) != 0) {
+        fprintf(stderr, "FAIL %s\n", name.c_str());
+        ++failures;
+    }
+}
+
+static bool supported(const char *feature)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (strcmp(feature, "sse4.2") == 0)
+        return __builtin_cpu_supports("sse4.2");
+    if (strcmp(feature, "avx2") == 0)
+        return __builtin_cpu_supports("avx2");
+    if (strcmp(feature, "avx512f") == 0)
+        return __builtin_cpu_supports("avx512f");
+#endif
+    (void)feature;
+    return false;
+}
+
+static void testGather(const char *name, GatherRunKernel kernel)
+{
+    const int freqStride = 4 * 7;
+    const RunPattern patterns[] = {RUN_IDENTITY, RUN_TRANSPOSED};
+    for (int p=0; p<2; ++p) {
+        for (int nFreq=1; nFreq<=13; ++nFreq) {
+            const std::vector<float> re = randomFloats(nFreq * freqStride);
+            const std::vector<float> im = randomFloats(nFreq * freqStride);
+            float sign[4];
+            for (int c=0; c<4; ++c)
+                sign[c] = rand() % 2 ? 1.0f : -1.0f;
+            std::vector<float> expected(8 * nFreq), got(8 * nFreq);
+            gatherRunScalar(re.data(), im.data(), freqStride, sign, patterns[p], nFreq, expected.data());
+            kernel(re.data(), im.data(), freqStride, sign, patterns[p], nFreq, got.data());
+            char label[64];
+            snprintf(label, sizeof(label), "gatherRun %s pattern %d nFreq %d", name, patterns[p], nFreq);
+            check(label, expected, got);
+        }
+    }
+}
+
+static void testComplexMul(const char *name, ComplexMulKernel kernel)
+{
+    for (int n=0; n<=37; ++n) {
+        const std::vector<float> factor = randomFloats(2 * n);
+        std::vector<float> expected = randomFloats(2 * n), got = expected;
+        complexMulScalar(factor.data(), expected.data(), n);
+        kernel(factor.data(), got.data(), n);
+        char label[64];
+        snprintf(label, sizeof(label), "complexMul %s n %d", name, n);
+        check(label, expected, got);
+    }
+}
+
+static void testJones(const char *name, JonesKernel kernel, JonesKernel reference, bool diagonal)
+{
+    for (int nFreq=1; nFreq<=11; ++nFreq) {
+        std::vector<float> j0 = randomFloats(8 * nFreq), j1 = randomFloats(8 * nFreq);
+        if (diagonal) {
+            for (int f=0; f<nFreq; ++f) {
+                std::fill(j0.begin() + 8*f + 2, j0.begin() + 8*f + 6, 0.0f);
+                std::fill(j1.begin() + 8*f + 2, j1.begin() + 8*f + 6, 0.0f);
+            }
+        }
+        std::vector<float> expected = randomFloats(8 * nFreq), got = expected;
+        reference(j0.data(), j1.data(), nFreq, expected.data());
+        kernel(j0.data(), j1.data(), nFreq, got.data());
+        char label[64];
+        snprintf(label, sizeof(label), "jones%s %s nFreq %d", diagonal ? "Diag" : "", name, nFreq);
+        check(label, expected, got);
+    }
+}
+
+int main()
+{
+    srand(12345);
+    int nTested = 0;
+    if (supported("sse4.2")) {
+        testGather("sse4.2", gatherRunSSE42);
+        testComplexMul("sse4.2", complexMulSSE42);
+        ++nTested;
+    }
+    if (supported("avx2")) {
+        testGather("avx2", gatherRunAVX2);
+        testComplexMul("avx2", complexMulAVX2);
+        testJones("avx2", jonesAVX2, jonesScalar, false);
+        testJones("avx2", jonesDiagAVX2, jonesDiagScalar, true);
+        ++nTested;
+    }
+    if (supported("avx512f")) {
+        testGather("avx512", gatherRunAVX512);
+        testComplexMul("avx512", complexMulAVX512);
+        testJones("avx512", jonesAVX512, jonesScalar, false);
+        testJones("avx512", jonesDiagAVX512, jonesDiagScalar, true);
+        ++nTested;
+    }
+    if (failures > 0) {
+        fprintf(stderr, "%d kernel checks failed\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("All kernels of %d instruction sets match the scalar versions\n", nTested);
+    return EXIT_SUCCESS;
+}